@@ -0,0 +1,268 @@
+#include "krlCache.h"
+
+//Layout: header, string lengths + characters for gcode and krl, then the raw krlMove, midpoint, layer
+//and preview vertex arrays. Bump the version whenever krlMove or this layout changes, changes to the
+//generated KRL text are covered by krlEmitVersion.
+static const uint32_t krlCacheVersion = 5;
+static const std::string krlCacheDir = "cache";
+
+//Entries beyond either limit are removed, least recently used first
+static const size_t krlCacheMaxEntries = 64;
+static const uint64_t krlCacheMaxBytes = 2ULL * 1024 * 1024 * 1024;
+
+struct krlCacheHeader {
+	char magic[4];
+	uint32_t version;
+	uint32_t emitVersion;
+	uint32_t moveSize;
+	uint32_t vertexSize;
+	uint64_t contentHash;
+	krlSettings settings;
+	uint32_t gCodeLines;
+	uint32_t krlLines;
+	uint32_t moves;
+	uint32_t midPoints;
+	uint32_t layers;
+	uint32_t polyVertices;
+};
+
+uint64_t krlHashBytes(const void* data, size_t size, uint64_t seed) {
+
+	const unsigned char* bytes = static_cast<const unsigned char*>(data);
+	uint64_t hash = seed;
+
+	for (size_t i = 0; i < size; i++) {
+		hash ^= bytes[i];
+		hash *= 1099511628211ULL;
+	}
+
+	return hash;
+}
+
+static uint64_t krlHashSettings(uint64_t seed, const krlSettings& settings) {
+
+	//Hash field by field, the struct itself may contain padding
+	uint64_t hash = krlHashBytes(&settings.origin.x, sizeof(float), seed);
+	hash = krlHashBytes(&settings.origin.y, sizeof(float), hash);
+	hash = krlHashBytes(&settings.heightOffset, sizeof(float), hash);
+	hash = krlHashBytes(&settings.speed, sizeof(float), hash);
+	hash = krlHashBytes(&settings.flowCorrection, sizeof(float), hash);
+	hash = krlHashBytes(&settings.layerHeight, sizeof(float), hash);
+	hash = krlHashBytes(&settings.rotation, sizeof(float), hash);
+
+	//Probe points only matter when they are used
+	uint8_t tilt = settings.tiltCompensation;
+	hash = krlHashBytes(&tilt, sizeof(tilt), hash);
+
+	if (tilt) {
+		for (const ofVec3f& p : settings.probe) {
+			hash = krlHashBytes(&p.x, sizeof(float) * 3, hash);
+		}
+	}
+
+	return hash;
+}
+
+static bool krlSameSettings(const krlSettings& a, const krlSettings& b) {
+	return krlSamePlacement(a, b) && a.speed == b.speed && a.flowCorrection == b.flowCorrection && a.layerHeight == b.layerHeight;
+}
+
+std::string krlCachePath(uint64_t contentHash, const krlSettings& settings) {
+	return krlCacheDir + "/" + ofToHex(krlHashSettings(contentHash, settings)) + ".krlc";
+}
+
+static void krlAppendLines(ofBuffer& out, const std::vector<std::string>& lines) {
+
+	std::vector<uint32_t> lengths;
+	lengths.reserve(lines.size());
+
+	for (auto& line : lines) {
+		lengths.push_back(line.size());
+	}
+
+	out.append(reinterpret_cast<const char*>(lengths.data()), lengths.size() * sizeof(uint32_t));
+
+	for (auto& line : lines) {
+		out.append(line.data(), line.size());
+	}
+}
+
+//Read lines back, advancing the cursor. False on a truncated file.
+static bool krlReadLines(const char*& cursor, const char* end, uint32_t count, std::vector<std::string>& lines) {
+
+	if (size_t(end - cursor) < count * sizeof(uint32_t)) return false;
+
+	const char* lengths = cursor;
+	cursor += count * sizeof(uint32_t);
+
+	lines.clear();
+	lines.reserve(count);
+
+	for (uint32_t i = 0; i < count; i++) {
+
+		uint32_t length;
+		memcpy(&length, lengths + i * sizeof(uint32_t), sizeof(uint32_t));
+
+		if (size_t(end - cursor) < length) return false;
+
+		lines.emplace_back(cursor, length);
+		cursor += length;
+	}
+
+	return true;
+}
+
+template<typename T>
+static bool krlReadArray(const char*& cursor, const char* end, uint32_t count, std::vector<T>& items) {
+
+	size_t bytes = size_t(count) * sizeof(T);
+	if (size_t(end - cursor) < bytes) return false;
+
+	items.resize(count);
+	memcpy(items.data(), cursor, bytes);
+	cursor += bytes;
+
+	return true;
+}
+
+bool krlCacheLoad(const std::string& path, uint64_t contentHash, const krlSettings& settings, krlConversion& conv) {
+
+	if (!ofFile::doesFileExist(path)) {
+		return false;
+	}
+
+	//One bulk read, everything below is copying out of this block
+	ofBuffer buf = ofBufferFromFile(path, true);
+
+	const char* cursor = buf.getData();
+	const char* end = cursor + buf.size();
+
+	krlCacheHeader header;
+	if (buf.size() < sizeof(header)) return false;
+
+	memcpy(&header, cursor, sizeof(header));
+	cursor += sizeof(header);
+
+	if (memcmp(header.magic, "KRLC", 4) != 0 || header.version != krlCacheVersion
+		|| header.emitVersion != krlEmitVersion || header.moveSize != sizeof(krlMove) || header.vertexSize != sizeof(ofDefaultVertexType)) {
+		std::cout << "Cache entry " << path << " has an old format, ignored" << std::endl;
+		return false;
+	}
+
+	//Hash collision or edited file, never trust an entry that doesn't match exactly
+	if (header.contentHash != contentHash || !krlSameSettings(header.settings, settings)) {
+		return false;
+	}
+
+	krlConversion loaded;
+	std::vector<ofDefaultVertexType> vertices;
+
+	bool ok = krlReadLines(cursor, end, header.gCodeLines, loaded.gCodeFilteredBuffer)
+		&& krlReadLines(cursor, end, header.krlLines, loaded.krlCodeBuffer)
+		&& krlReadArray(cursor, end, header.moves, loaded.toolpathBuffer)
+		&& krlReadArray(cursor, end, header.midPoints, loaded.midPointCollection)
+		&& krlReadArray(cursor, end, header.layers, loaded.layerIndex)
+		&& krlReadArray(cursor, end, header.polyVertices, vertices);
+
+	if (!ok) {
+		std::cout << "Cache entry " << path << " is truncated, ignored" << std::endl;
+		return false;
+	}
+
+	loaded.guiPoly.addVertices(vertices);
+	loaded.settings = header.settings;
+	conv = std::move(loaded);
+
+	//The modification time doubles as last use for eviction
+	std::error_code error;
+	std::filesystem::last_write_time(ofToDataPath(path), std::filesystem::file_time_type::clock::now(), error);
+
+	return true;
+}
+
+//Remove the least recently used entries until the cache fits its limits, never the one just written
+static void krlCacheTrim(const std::string& keep) {
+
+	struct entry {
+		std::string path;
+		uint64_t size;
+		std::filesystem::file_time_type used;
+	};
+
+	ofDirectory dir(krlCacheDir);
+	dir.allowExt("krlc");
+	dir.listDir();
+
+	std::vector<entry> entries;
+	entries.reserve(dir.size());
+
+	for (size_t i = 0; i < dir.size(); i++) {
+
+		std::error_code error;
+		std::string path = dir.getPath(i);
+		auto used = std::filesystem::last_write_time(ofToDataPath(path), error);
+
+		if (!error) {
+			entries.push_back({ path, dir.getFile(i).getSize(), used });
+		}
+	}
+
+	//Newest first, everything past the limits goes
+	std::sort(entries.begin(), entries.end(), [](const entry& a, const entry& b) { return a.used > b.used; });
+
+	//The new entry always stays, so it counts against the limits first
+	size_t count = 1;
+	uint64_t bytes = ofFile(keep).getSize();
+
+	for (const entry& e : entries) {
+
+		if (ofToDataPath(e.path) == ofToDataPath(keep)) continue;
+
+		count++;
+		bytes += e.size;
+
+		if (count > krlCacheMaxEntries || bytes > krlCacheMaxBytes) {
+			std::cout << "Cache entry " << e.path << " evicted" << std::endl;
+			ofFile::removeFile(e.path);
+		}
+	}
+}
+
+bool krlCacheStore(const std::string& path, uint64_t contentHash, const krlSettings& settings, const krlConversion& conv) {
+
+	const auto& vertices = conv.guiPoly.getVertices();
+
+	krlCacheHeader header = {};
+	memcpy(header.magic, "KRLC", 4);
+	header.version = krlCacheVersion;
+	header.emitVersion = krlEmitVersion;
+	header.moveSize = sizeof(krlMove);
+	header.vertexSize = sizeof(ofDefaultVertexType);
+	header.contentHash = contentHash;
+	header.settings = settings;
+	header.gCodeLines = conv.gCodeFilteredBuffer.size();
+	header.krlLines = conv.krlCodeBuffer.size();
+	header.moves = conv.toolpathBuffer.size();
+	header.midPoints = conv.midPointCollection.size();
+	header.layers = conv.layerIndex.size();
+	header.polyVertices = vertices.size();
+
+	ofBuffer out;
+	out.append(reinterpret_cast<const char*>(&header), sizeof(header));
+	krlAppendLines(out, conv.gCodeFilteredBuffer);
+	krlAppendLines(out, conv.krlCodeBuffer);
+	out.append(reinterpret_cast<const char*>(conv.toolpathBuffer.data()), conv.toolpathBuffer.size() * sizeof(krlMove));
+	out.append(reinterpret_cast<const char*>(conv.midPointCollection.data()), conv.midPointCollection.size() * sizeof(ofVec3f));
+	out.append(reinterpret_cast<const char*>(conv.layerIndex.data()), conv.layerIndex.size() * sizeof(krlLayer));
+	out.append(reinterpret_cast<const char*>(vertices.data()), vertices.size() * sizeof(ofDefaultVertexType));
+
+	ofDirectory::createDirectory(krlCacheDir, true, true);
+
+	if (!ofBufferToFile(path, out, true)) {
+		return false;
+	}
+
+	krlCacheTrim(path);
+
+	return true;
+}
@@ -0,0 +1,16 @@
+#pragma once
+
+#include "ofMain.h"
+#include "krlConverter.h"
+
+//On-disk cache of finished conversions. An entry is keyed on the hash of the raw .gcode content
+//together with the krlSettings, so reopening and processing an unchanged job skips the conversion.
+
+//64 bit FNV-1a, continue a running hash by passing it as seed
+uint64_t krlHashBytes(const void* data, size_t size, uint64_t seed = 14695981039346656037ULL);
+
+//File (relative to data/) that holds the conversion of this content with these settings
+std::string krlCachePath(uint64_t contentHash, const krlSettings& settings);
+
+bool krlCacheLoad(const std::string& path, uint64_t contentHash, const krlSettings& settings, krlConversion& conv);
+bool krlCacheStore(const std::string& path, uint64_t contentHash, const krlSettings& settings, const krlConversion& conv);
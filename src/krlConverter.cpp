@@ -0,0 +1,576 @@
+#include "krlConverter.h"
+
+void krlConversion::clear() {
+	gCodeFilteredBuffer.clear();
+	krlCodeBuffer.clear();
+	toolpathBuffer.clear();
+	midPointCollection.clear();
+	layerIndex.clear();
+	guiPoly.clear();
+}
+
+std::vector<std::string> krlFilterGCode(const ofBuffer& buffer, bool verbose) {
+
+	std::vector<std::string> gCode;
+
+	unsigned int lNum = 0;
+	for (auto line : buffer.getLines()) {
+
+		if (!line.empty()) {
+
+			if (line.at(0) == 'G' || line.at(0) == 'M') {
+
+				gCode.push_back(line);
+
+			}
+			else if (verbose) {
+
+				std::cout << "Discarded line " << lNum << ": " << line << std::endl;
+
+			}
+
+		}
+
+		lNum++;
+
+	}
+
+	return gCode;
+}
+
+void krlParseGCode(const std::vector<std::string>& gCode, krlConversion& conv, bool verbose) {
+
+	conv.clear();
+
+	unsigned int lineNumber = 1;
+	bool firstLinear = false;
+	ofVec3f lastPosition = ofVec3f(0, 0, 0);
+	ofVec3f currentPosition = ofVec3f(0, 0, 0);
+
+	ofPolyline cPoly;
+
+	for (auto& line : gCode) {
+
+		bool processFlag = false;
+		ofVec2f currentArcOffset = ofVec2f(0, 0);
+		bool hasE = line.find('E') != std::string::npos;
+
+		bool hasX = line.find('X') != std::string::npos;
+		bool hasY = line.find('Y') != std::string::npos;
+		bool hasZ = line.find('Z') != std::string::npos;
+
+		bool hasI = line.find('I') != std::string::npos;
+		bool hasJ = line.find('J') != std::string::npos;
+
+		if (hasX) {
+			currentPosition.x = std::stof(line.substr(line.find('X') + 1, (line.find(' ', line.find('X')) - (line.find('X') + 1))));
+		}
+		if (hasY) {
+			currentPosition.y = std::stof(line.substr(line.find('Y') + 1, (line.find(' ', line.find('Y')) - (line.find('Y') + 1))));
+		}
+		if (hasZ) {
+			currentPosition.z = std::stof(line.substr(line.find('Z') + 1, (line.find(' ', line.find('Z')) - (line.find('Z') + 1))));
+		}
+
+		if (hasI) {
+			currentArcOffset.x = std::stof(line.substr(line.find('I') + 1, (line.find(' ', line.find('I')) - (line.find('I') + 1))));
+		}
+		if (hasJ) {
+			currentArcOffset.y = std::stof(line.substr(line.find('J') + 1, (line.find(' ', line.find('J')) - (line.find('J') + 1))));
+		}
+
+		if (line.find("G0") != std::string::npos || line.find("G1") != std::string::npos) {
+
+			//Z only moves just change position if the coordinate is new
+			bool newZ = hasZ && !hasX && !hasY && lastPosition.z != currentPosition.z;
+
+			if (newZ && verbose) {
+				std::cout << "Make new point, old z: " << lastPosition.z << ",new z: " << currentPosition.z << std::endl;
+			}
+
+			if (newZ || (hasX && hasY)) {
+
+				cPoly.addVertex(currentPosition);
+
+				//First linear move of the program is a PTP
+				krlMove move;
+				move.type = firstLinear ? krlMove::LIN : krlMove::PTP;
+				move.extruding = hasE;
+				move.clockwise = false;
+				move.gCodeLine = conv.gCodeFilteredBuffer.size();
+				move.krlLine = 0;
+				move.target = currentPosition;
+				move.aux = currentPosition;
+				move.center = currentPosition;
+				conv.toolpathBuffer.push_back(move);
+
+				firstLinear = true;
+				processFlag = true;
+
+			}
+
+		}
+		else if (line.find("G21") != std::string::npos) {
+			//Catch this exception, do nothing!
+			if (verbose) std::cout << "G21 found at " << lineNumber << std::endl;
+		}
+		else if (line.find("G2") != std::string::npos || line.find("G3") != std::string::npos) {
+
+			//G2 is clockwise, G3 counterclockwise
+			bool clockwise = line.find("G2") != std::string::npos;
+
+			if (hasI && hasJ && hasX && hasY) {
+
+				//Gui calculations
+				ofVec2f arcCent = ofVec2f(lastPosition.x + currentArcOffset.x, lastPosition.y + currentArcOffset.y);
+				float arcRad = sqrt(pow(abs(currentArcOffset.x), 2) + pow(abs(currentArcOffset.y), 2));
+				float startAngle = atan2(lastPosition.y - arcCent.y, lastPosition.x - arcCent.x) * (180 / PI);
+				float endAngle = atan2(currentPosition.y - arcCent.y, currentPosition.x - arcCent.x) * (180 / PI);
+
+				if (clockwise) {
+					cPoly.arcNegative(arcCent.x, arcCent.y, currentPosition.z, arcRad, arcRad, startAngle, endAngle);
+				}
+				else {
+					cPoly.arc(arcCent.x, arcCent.y, currentPosition.z, arcRad, arcRad, startAngle, endAngle);
+				}
+
+				//Auxilary point calculations for KRL (midpoint)
+				float startAngleRad = atan2(lastPosition.y - arcCent.y, lastPosition.x - arcCent.x);
+				float endAngleRad = atan2(currentPosition.y - arcCent.y, currentPosition.x - arcCent.x);
+
+				float a = clockwise ? startAngleRad - endAngleRad : endAngleRad - startAngleRad;
+				float aDelta = atan2(sin(a), cos(a));
+
+				if (aDelta < 0) {
+					aDelta += 2 * PI;
+				}
+
+				float midAngleRad = clockwise ? startAngleRad - (aDelta / 2) : startAngleRad + (aDelta / 2);
+				float midPx = (cos(midAngleRad) * arcRad) + arcCent.x;
+				float midPy = (sin(midAngleRad) * arcRad) + arcCent.y;
+				float midPz = currentPosition.z - ((currentPosition.z - lastPosition.z) / 2);
+
+				ofVec3f midPointCoord = ofVec3f(midPx, midPy, midPz);
+
+				conv.midPointCollection.push_back(midPointCoord);
+
+				krlMove move;
+				move.type = krlMove::CIRC;
+				move.extruding = hasE;
+				move.clockwise = clockwise;
+				move.gCodeLine = conv.gCodeFilteredBuffer.size();
+				move.krlLine = 0;
+				move.target = currentPosition;
+				move.aux = midPointCoord;
+				move.center = ofVec3f(arcCent.x, arcCent.y, midPz);
+				conv.toolpathBuffer.push_back(move);
+
+			}
+			else {
+
+				std::cout << "Error; parameters for arc not found, ln: " << lineNumber << std::endl;
+			}
+
+			processFlag = true;
+
+		}
+		else {
+
+			//Do nothing for now
+
+		}
+
+		if (verbose) {
+			std::cout << lineNumber << " (" << processFlag << ": " << currentPosition.x << ", " << currentPosition.y << ", " << currentPosition.z << " :: " << line << std::endl;
+		}
+
+		//Save for comparison with KRL in gui
+		if (processFlag) {
+			conv.gCodeFilteredBuffer.push_back(line);
+		}
+
+		//Save position for references in arcs
+		lastPosition = currentPosition;
+		lineNumber++;
+
+	}
+
+	conv.guiPoly = cPoly;
+
+}
+
+void krlEmitCode(krlConversion& conv, const krlSettings& settings) {
+
+	conv.krlCodeBuffer.clear();
+	conv.krlCodeBuffer.reserve(conv.toolpathBuffer.size());
+	conv.layerIndex.clear();
+	conv.settings = settings;
+
+	//Place the whole toolpath in one pass up front, the loop below only formats
+	std::vector<krlMove> placed = conv.toolpathBuffer;
+	krlPlaceToolpath(placed, krlMakePlacement(settings));
+
+	bool isExtruding = false;
+
+	//Start of the current run of non extruding moves, a new layer begins there
+	bool inTravel = false;
+	uint32_t travelMove = 0;
+	uint32_t travelLine = 0;
+	bool travelExtruding = false;
+
+	for (uint32_t i = 0; i < conv.toolpathBuffer.size(); i++) {
+
+		krlMove& move = conv.toolpathBuffer[i];
+		uint32_t lineBefore = conv.krlCodeBuffer.size();
+
+		if (!move.extruding && !inTravel) {
+			inTravel = true;
+			travelMove = i;
+			travelLine = lineBefore;
+			travelExtruding = isExtruding;
+		}
+
+		if (move.extruding) {
+
+			if (conv.layerIndex.empty() || move.target.z >= conv.layerIndex.back().z + settings.layerHeight * 0.5f) {
+
+				krlLayer layer;
+				layer.z = move.target.z;
+				layer.firstMove = inTravel ? travelMove : i;
+				layer.firstKrlLine = inTravel ? travelLine : lineBefore;
+				layer.extruding = inTravel ? travelExtruding : isExtruding;
+
+				//Everything before the first extrusion is part of the first layer
+				if (conv.layerIndex.empty()) {
+					layer.firstMove = 0;
+					layer.firstKrlLine = 0;
+					layer.extruding = false;
+				}
+				else {
+					conv.layerIndex.back().lastMove = layer.firstMove - 1;
+					conv.layerIndex.back().lastKrlLine = layer.firstKrlLine - 1;
+				}
+
+				conv.layerIndex.push_back(layer);
+			}
+
+			inTravel = false;
+		}
+
+		//Switch extrusion on and off
+		if (move.extruding && !isExtruding) {
+
+			conv.krlCodeBuffer.push_back("TRIGGER WHEN DISTANCE = 0 DELAY = 0 DO O_EXTRUDER_START = TRUE");
+			isExtruding = true;
+
+		}
+
+		if (!move.extruding && isExtruding) {
+
+			conv.krlCodeBuffer.push_back("TRIGGER WHEN DISTANCE = 0 DELAY = 0 DO O_EXTRUDER_START = FALSE");
+			isExtruding = false;
+		}
+
+		ofVec3f t = placed[i].target;
+		move.krlLine = conv.krlCodeBuffer.size();
+
+		if (move.type == krlMove::PTP) {
+			conv.krlCodeBuffer.push_back("PTP {X " + ofToString(t.x, 1) + ", Y " + ofToString(t.y, 1) + ", Z " + ofToString(t.z, 1) + ", A 0, B 90, C 0, E1 0, E2 0, E3 0, E4 0, S 'B 110'} C_PTP");
+		}
+		else if (move.type == krlMove::LIN) {
+			conv.krlCodeBuffer.push_back("LIN{ X " + ofToString(t.x, 1) + ", Y " + ofToString(t.y, 1) + ", Z " + ofToString(t.z, 1) + ", A 0, B 90, C 0 } C_DIS");
+		}
+		else {
+			ofVec3f m = placed[i].aux;
+			conv.krlCodeBuffer.push_back("CIRC { X " + ofToString(m.x, 1) + ", Y " + ofToString(m.y, 1) + ", Z " + ofToString(m.z, 1) + "},{ X " + ofToString(t.x, 1) + ", Y " + ofToString(t.y, 1) + ", Z " + ofToString(t.z, 1) + ", A 0, B 90, C 0} C_DIS");
+		}
+
+	}
+
+	if (!conv.layerIndex.empty()) {
+		conv.layerIndex.back().lastMove = conv.toolpathBuffer.size() - 1;
+		conv.layerIndex.back().lastKrlLine = conv.krlCodeBuffer.size() - 1;
+	}
+
+}
+
+void krlAppendProgramHeader(std::vector<std::string>& krlOutput, const krlSettings& settings) {
+
+	krlOutput.push_back("DEF ofgen()");
+
+	krlOutput.push_back("GLOBAL INTERRUPT DECL 3 WHEN $STOPMESS==TRUE DO IR_STOPM ( )");
+	krlOutput.push_back("INTERRUPT ON 3");
+	krlOutput.push_back("BAS (#INITMOV,0 )");
+
+	krlOutput.push_back("ANOUT ON AO_EXTRUDER_RPM = FLOW_CORRECTION * $VEL_ACT +0.0 DELAY=-0.2");
+	krlOutput.push_back("FLOW_CORRECTION = " + ofToString(settings.flowCorrection, 3));
+
+	krlOutput.push_back("$BWDSTART = FALSE");
+	krlOutput.push_back("PDAT_ACT = {VEL 15,ACC 100,APO_DIST 50}");
+	krlOutput.push_back("BAS(#PTP_DAT)");
+	krlOutput.push_back("FDAT_ACT = {TOOL_NO 6,BASE_NO 0,IPO_FRAME #BASE}");
+	krlOutput.push_back("BAS(#FRAMES)");
+
+	krlOutput.push_back("BAS (#VEL_PTP,15)");
+	krlOutput.push_back("PTP  {A1 5,A2 -90,A3 100,A4 5,A5 -10,A6 -5,E1 0,E2 0,E3 0,E4 0}");
+
+	krlOutput.push_back("$VEL.CP=" + ofToString(settings.speed, 2));
+	krlOutput.push_back("$ADVANCE=3");
+
+}
+
+std::vector<std::string> krlCompileProgram(const krlConversion& conv, const krlSettings& settings) {
+
+	std::vector<std::string> krlOutput;
+	krlOutput.reserve(conv.krlCodeBuffer.size() + 16);
+
+	krlAppendProgramHeader(krlOutput, settings);
+
+	krlOutput.insert(krlOutput.end(), conv.krlCodeBuffer.begin(), conv.krlCodeBuffer.end());
+
+	krlOutput.push_back("END");
+
+	return krlOutput;
+}
+
+std::vector<std::string> krlCompileRestartProgram(const krlConversion& conv, const krlSettings& settings, uint32_t layer, float approachHeight) {
+
+	std::vector<std::string> krlOutput;
+
+	if (layer >= conv.layerIndex.size()) {
+		return krlOutput;
+	}
+
+	const krlLayer& restart = conv.layerIndex[layer];
+	krlOutput.reserve(conv.krlCodeBuffer.size() - restart.firstKrlLine + 24);
+
+	krlAppendProgramHeader(krlOutput, settings);
+
+	//The first move of the layer starts where the move before it ended
+	uint32_t startMove = restart.firstMove > 0 ? restart.firstMove - 1 : restart.firstMove;
+	ofVec3f start = krlMakePlacement(conv.settings).apply(conv.toolpathBuffer[startMove].target);
+
+	krlOutput.push_back(";Restart at layer " + ofToString(layer) + ", Z " + ofToString(restart.z, 2) + " (slicer)");
+	krlOutput.push_back("O_EXTRUDER_START = FALSE");
+	krlOutput.push_back("PTP {X " + ofToString(start.x, 1) + ", Y " + ofToString(start.y, 1) + ", Z " + ofToString(start.z + approachHeight, 1) + ", A 0, B 90, C 0, E1 0, E2 0, E3 0, E4 0, S 'B 110'} C_PTP");
+	krlOutput.push_back("LIN{ X " + ofToString(start.x, 1) + ", Y " + ofToString(start.y, 1) + ", Z " + ofToString(start.z, 1) + ", A 0, B 90, C 0 }");
+
+	//A layer that opens with travel switches the extruder off in its own lines, only switch it on here
+	//when the first move of the layer extrudes without a trigger of its own
+	if (restart.extruding && conv.toolpathBuffer[restart.firstMove].extruding) {
+		krlOutput.push_back("TRIGGER WHEN DISTANCE = 0 DELAY = 0 DO O_EXTRUDER_START = TRUE");
+	}
+
+	krlOutput.insert(krlOutput.end(), conv.krlCodeBuffer.begin() + restart.firstKrlLine, conv.krlCodeBuffer.end());
+
+	krlOutput.push_back("END");
+
+	return krlOutput;
+}
+
+bool krlFitBedPlane(const ofVec3f probe[3], ofVec3f& normal, ofVec3f& center) {
+
+	normal = (probe[1] - probe[0]).getCrossed(probe[2] - probe[0]);
+	center = (probe[0] + probe[1] + probe[2]) / 3.0f;
+
+	//Points (nearly) on one line, 1 mm2 of triangle area at least
+	if (normal.length() < 2.0f) {
+		return false;
+	}
+
+	normal.normalize();
+
+	if (normal.z < 0) {
+		normal = -normal;
+	}
+
+	return true;
+}
+
+krlPlacement krlMakePlacement(const krlSettings& settings) {
+
+	krlPlacement placement;
+
+	float c = cos(ofDegToRad(settings.rotation));
+	float s = sin(ofDegToRad(settings.rotation));
+
+	placement.xAxis = ofVec3f(c, s, 0);
+	placement.yAxis = ofVec3f(-s, c, 0);
+	placement.zAxis = ofVec3f(0, 0, 1);
+	placement.translation = ofVec3f(settings.origin.x, settings.origin.y, settings.heightOffset);
+
+	ofVec3f normal;
+	ofVec3f center;
+
+	if (settings.tiltCompensation && krlFitBedPlane(settings.probe, normal, center)) {
+
+		//Shortest rotation taking Z onto the bed normal, pivoting around the probe center at Z 0
+		ofVec3f axis = ofVec3f(0, 0, 1).getCrossed(normal);
+		float angle = ofRadToDeg(acos(ofClamp(normal.z, -1, 1)));
+		ofVec3f pivot = ofVec3f(center.x, center.y, 0);
+
+		if (axis.length() > 1e-6f) {
+			placement.xAxis.rotate(angle, axis);
+			placement.yAxis.rotate(angle, axis);
+			placement.zAxis.rotate(angle, axis);
+			placement.translation = (placement.translation - pivot).getRotated(angle, axis) + pivot;
+		}
+
+		placement.translation.z += center.z;
+	}
+
+	return placement;
+}
+
+bool krlSamePlacement(const krlSettings& a, const krlSettings& b) {
+	return a.origin.x == b.origin.x && a.origin.y == b.origin.y && a.heightOffset == b.heightOffset
+		&& a.rotation == b.rotation && a.tiltCompensation == b.tiltCompensation
+		&& (!a.tiltCompensation || (a.probe[0] == b.probe[0] && a.probe[1] == b.probe[1] && a.probe[2] == b.probe[2]));
+}
+
+void krlPlaceToolpath(std::vector<krlMove>& toolpath, const krlPlacement& placement) {
+
+	//Straight multiply-adds over the array, aux is transformed for every move so the loop has no branches
+	const ofVec3f x = placement.xAxis;
+	const ofVec3f y = placement.yAxis;
+	const ofVec3f z = placement.zAxis;
+	const ofVec3f t = placement.translation;
+
+	for (krlMove& move : toolpath) {
+
+		const ofVec3f p = move.target;
+		const ofVec3f a = move.aux;
+
+		move.target = ofVec3f(x.x * p.x + y.x * p.y + z.x * p.z + t.x, x.y * p.x + y.y * p.y + z.y * p.z + t.y, x.z * p.x + y.z * p.y + z.z * p.z + t.z);
+		move.aux = ofVec3f(x.x * a.x + y.x * a.y + z.x * a.z + t.x, x.y * a.x + y.y * a.y + z.y * a.z + t.y, x.z * a.x + y.z * a.y + z.z * a.z + t.z);
+	}
+
+}
+
+std::string krlSanitizeSavePath(const std::string& path) {
+
+	//Apart from normal filename illegalness (!,/,\) Kuka doesnt like hyphens!
+	std::string sanitized = path;
+	size_t changeFrom = sanitized.find_last_of("/\\");
+	changeFrom = changeFrom == std::string::npos ? 0 : changeFrom;
+
+	std::replace(sanitized.begin() + changeFrom, sanitized.end(), '-', '_');
+
+	return sanitized;
+}
+
+bool krlWriteProgram(const std::string& path, const std::vector<std::string>& program) {
+
+	ofFile nFile = ofFile(path, ofFile::Mode::Append, false);
+
+	if (nFile.exists()) {
+		nFile.remove();
+	}
+
+	if (nFile.create()) {
+		if (nFile.open(path, ofFile::Mode::Append, false)) {
+
+			for (auto& i : program) {
+				nFile << i << '\n';
+			}
+
+			nFile.close();
+
+			return true;
+		}
+
+	}
+
+	return false;
+}
+
+float krlCalculateFlowCorrection(float layerHeight, float layerWidth, float volumePerRev, float speed, bool verbose) {
+
+	if (verbose) std::cout << "Inputs: " << layerHeight << ", " << layerWidth << ", " << speed << std::endl;
+
+	if (speed <= 0 || volumePerRev <= 0) {
+		return 0;
+	}
+
+	//Calculate surface of extrusion over Z-X, which is a slot. Take rectangular volume, subtract the round corners
+	//by subtracting round layer height from square layer height. 
+	float eSurface = (layerHeight * layerWidth) - ((layerHeight * layerHeight) - (PI * ((layerHeight / 2) * (layerHeight / 2))));
+
+	//Calculate distance traveled per minute
+	float dMinute = speed * 60.0f;
+	if (verbose) std::cout << "Traveled distance per minute [m/min]: " << dMinute << std::endl;
+
+	//Multiply the distance traveled at max speed by theoretical extruded cross section
+	float eVolumeMinute = (dMinute * 1000.0f) * eSurface;
+	if (verbose) std::cout << "Extrusion volume at max speed [mm3/min]: " << eVolumeMinute << std::endl;
+
+	//Put previous calculated volume in its final perspective for volume; convert from mm3 to cm3
+	eVolumeMinute = eVolumeMinute / 1000.0f;
+	if (verbose) std::cout << "Extrusion volume at max speed [cm3/min]: " << eVolumeMinute << std::endl;
+
+	//Devide the requested volume per minute by the volume provided per rotation resulting in RPM
+	float calculatedFeed = eVolumeMinute / volumePerRev;
+	if (verbose) std::cout << "Calculated feed [RPM] : " << calculatedFeed << std::endl;
+
+	//Min 0, max 150 rpm
+	return ofMap(calculatedFeed, 0, 150, 0, 1, true) / speed;
+}
+
+bool krlLoadSettings(const std::string& xmlPath, krlSettings& settings) {
+
+	ofXml xml;
+	if (!xml.load(xmlPath)) {
+		return false;
+	}
+
+	//Same element names ofxPanel uses for settings.xml
+	auto origin = xml.findFirst("//Print_origin__mm_");
+	if (origin) {
+		std::vector<std::string> xy = ofSplitString(origin.getValue(), ",", true, true);
+		if (xy.size() == 2) {
+			settings.origin = ofVec2f(ofToFloat(xy[0]), ofToFloat(xy[1]));
+		}
+	}
+
+	auto layerHeight = xml.findFirst("//Layer_height__mm_");
+	if (layerHeight) settings.layerHeight = layerHeight.getFloatValue();
+
+	auto layerWidth = xml.findFirst("//Layer_width__mm_");
+	if (layerWidth) settings.layerWidth = layerWidth.getFloatValue();
+
+	auto volumePerRev = xml.findFirst("//Volume_per_rotation__cm3_rev_");
+	if (volumePerRev) settings.volumePerRev = volumePerRev.getFloatValue();
+
+	auto heightOffset = xml.findFirst("//Print_Z_offset__mm_");
+	if (heightOffset) settings.heightOffset = heightOffset.getFloatValue();
+
+	auto speed = xml.findFirst("//Print_speed__m_s_");
+	if (speed) settings.speed = speed.getFloatValue();
+
+	//Never take the stored value next to new inputs, the GUI derives it from them as well
+	if (layerHeight || layerWidth || volumePerRev || speed) {
+		settings.flowCorrection = krlCalculateFlowCorrection(settings.layerHeight, settings.layerWidth, settings.volumePerRev, settings.speed, false);
+	}
+	else {
+		auto flowCorrection = xml.findFirst("//Calculated_flowC__mult_");
+		if (flowCorrection) settings.flowCorrection = flowCorrection.getFloatValue();
+	}
+
+	auto rotation = xml.findFirst("//Print_rotation__deg_");
+	if (rotation) settings.rotation = rotation.getFloatValue();
+
+	auto tiltCompensation = xml.findFirst("//Tilt_compensation");
+	if (tiltCompensation) settings.tiltCompensation = tiltCompensation.getBoolValue();
+
+	for (int i = 0; i < 3; i++) {
+		auto probe = xml.findFirst("//Bed_probe_" + ofToString(i + 1) + "__mm_");
+		if (probe) {
+			std::vector<std::string> xyz = ofSplitString(probe.getValue(), ",", true, true);
+			if (xyz.size() == 3) {
+				settings.probe[i] = ofVec3f(ofToFloat(xyz[0]), ofToFloat(xyz[1]), ofToFloat(xyz[2]));
+			}
+		}
+	}
+
+	return true;
+}
@@ -0,0 +1,119 @@
+#pragma once
+
+#include "ofMain.h"
+
+//Single motion of the converted toolpath. Coordinates are kept in slicer space, origin and Z offset
+//are only added when the KRL is emitted. Plain data on purpose, the cache writes these as-is.
+struct krlMove {
+	enum : uint8_t { PTP = 0, LIN = 1, CIRC = 2 };
+
+	uint8_t type;
+	uint8_t extruding;
+	uint8_t clockwise;		//CIRC from G2, counterclockwise from G3
+	uint32_t gCodeLine;		//Line in gCodeFilteredBuffer that produced this move
+	uint32_t krlLine;		//Line in krlCodeBuffer holding the motion command (set on emit)
+	ofVec3f target;
+	ofVec3f aux;			//CIRC auxiliary point (arc midpoint), unused for PTP/LIN
+	ofVec3f center;			//CIRC center from I/J at the height of the aux point, unused for PTP/LIN
+};
+
+//Layer of the toolpath. A layer starts at the first extruding move at least half a layer height above
+//the previous layer, the travel leading up to that move belongs to the new layer. Z only moves don't
+//mark layers on their own, they also show up for z-hops and are missing in spiral vase prints.
+struct krlLayer {
+	float z;
+	uint32_t firstMove;
+	uint32_t lastMove;
+	uint32_t firstKrlLine;
+	uint32_t lastKrlLine;
+	uint8_t extruding;		//Extruder state when entering the layer
+};
+
+//All user parameters that end up in the generated KRL
+struct krlSettings {
+	ofVec2f origin;
+	float heightOffset;
+	float speed;
+	float flowCorrection;
+	float layerHeight;
+	float layerWidth;		//Only used to calculate flowCorrection
+	float volumePerRev;		//Only used to calculate flowCorrection
+	float rotation;			//Rotation of the part around the slicer origin [deg]
+	bool tiltCompensation;	//Lay the part on the plane through the probe points instead of the XY plane
+	ofVec3f probe[3];		//Points probed on the build plate, robot base frame
+};
+
+//Rigid transform from slicer coordinates to the robot base frame, p' = xAxis * p.x + yAxis * p.y + zAxis * p.z + translation
+struct krlPlacement {
+	ofVec3f xAxis;
+	ofVec3f yAxis;
+	ofVec3f zAxis;
+	ofVec3f translation;
+
+	ofVec3f apply(const ofVec3f& p) const {
+		return xAxis * p.x + yAxis * p.y + zAxis * p.z + translation;
+	}
+};
+
+//Result of a conversion run, everything the preview and the save need
+struct krlConversion {
+	std::vector<std::string> gCodeFilteredBuffer;
+	std::vector<std::string> krlCodeBuffer;
+	std::vector<krlMove> toolpathBuffer;
+	std::vector<ofVec3f> midPointCollection;
+	std::vector<krlLayer> layerIndex;
+	ofPolyline guiPoly;
+	krlSettings settings;	//What krlEmitCode ran with, everything placed to match krlCodeBuffer uses these
+
+	void clear();
+};
+
+//Keep only the G and M lines of a raw .gcode buffer
+std::vector<std::string> krlFilterGCode(const ofBuffer& buffer, bool verbose);
+
+//Turn G0/G1/G2/G3 lines into the toolpath, preview polyline and arc midpoints
+void krlParseGCode(const std::vector<std::string>& gCode, krlConversion& conv, bool verbose);
+
+//Generate the KRL motion lines (krlCodeBuffer) and the layer index from the parsed toolpath.
+//Bump krlEmitVersion whenever the text it writes changes, cached conversions with older output are then discarded.
+static const uint32_t krlEmitVersion = 1;
+void krlEmitCode(krlConversion& conv, const krlSettings& settings);
+
+//Controller setup shared by every generated program, DEF ofgen() up to and including the home PTP and speed
+void krlAppendProgramHeader(std::vector<std::string>& krlOutput, const krlSettings& settings);
+
+//Complete DEF ofgen() program: controller setup, the emitted motion lines and END
+std::vector<std::string> krlCompileProgram(const krlConversion& conv, const krlSettings& settings);
+
+//Program that restarts a failed print at the given layer: extruder off, PTP above the start of the layer,
+//LIN down onto it, restore the extruder state of the layer entry and continue with the rest of the program.
+//The approach is placed with conv.settings so it lands where the emitted lines continue, settings only
+//feeds the program header.
+std::vector<std::string> krlCompileRestartProgram(const krlConversion& conv, const krlSettings& settings, uint32_t layer, float approachHeight);
+
+//Plane through the three probe points, normal facing up. False when the points don't span a plane.
+bool krlFitBedPlane(const ofVec3f probe[3], ofVec3f& normal, ofVec3f& center);
+
+//Rotation around Z, then translation to origin and Z offset, then with tilt compensation the rotation of the
+//Z axis onto the bed normal around the probe center. The Z offset is then measured from the probed plane.
+krlPlacement krlMakePlacement(const krlSettings& settings);
+
+//True when both settings put the toolpath in the same place
+bool krlSamePlacement(const krlSettings& a, const krlSettings& b);
+
+//Place the targets and CIRC auxiliary points of the whole toolpath in one pass
+void krlPlaceToolpath(std::vector<krlMove>& toolpath, const krlPlacement& placement);
+
+//Kuka doesn't like hyphens in file names, replace them in the file name part of the path
+std::string krlSanitizeSavePath(const std::string& path);
+
+bool krlWriteProgram(const std::string& path, const std::vector<std::string>& program);
+
+//FLOW_CORRECTION for the extruder rpm: bead cross section times travel at print speed gives the volume per minute,
+//divided by the volume per rotation the rpm. Mapped from 0-150 rpm to 0-1 and divided by the speed, the controller
+//multiplies it with $VEL_ACT. Returns 0 without a speed.
+float krlCalculateFlowCorrection(float layerHeight, float layerWidth, float volumePerRev, float speed, bool verbose);
+
+//Read settings from a settings.xml style file, fields missing in the file keep their current value. The flow
+//correction is recalculated when the file sets any of its inputs, a stored value would not match them.
+bool krlLoadSettings(const std::string& xmlPath, krlSettings& settings);
@@ -0,0 +1,159 @@
+#include "krlPickIndex.h"
+
+static const uint32_t krlPickLeafSize = 4;
+
+void krlPickIndex::clear() {
+	segments.clear();
+	nodes.clear();
+}
+
+bool krlPickIndex::empty() const {
+	return nodes.empty();
+}
+
+void krlPickIndex::build(const std::vector<krlMove>& toolpath) {
+
+	clear();
+
+	if (toolpath.empty()) {
+		return;
+	}
+
+	segments.reserve(toolpath.size() + toolpath.size() / 2);
+
+	ofVec3f last = toolpath.front().target;
+
+	for (uint32_t i = 0; i < toolpath.size(); i++) {
+
+		const krlMove& move = toolpath[i];
+
+		if (move.type == krlMove::CIRC) {
+			segments.push_back({ last, move.aux, i });
+			segments.push_back({ move.aux, move.target, i });
+		}
+		else {
+			segments.push_back({ last, move.target, i });
+		}
+
+		last = move.target;
+	}
+
+	nodes.reserve(segments.size());
+	nodes.push_back(node());
+
+	buildNode(0, 0, segments.size());
+
+}
+
+void krlPickIndex::buildNode(uint32_t nodeIndex, uint32_t first, uint32_t count) {
+
+	ofVec3f bMin = segments[first].a;
+	ofVec3f bMax = segments[first].a;
+
+	for (uint32_t i = first; i < first + count; i++) {
+		for (const ofVec3f* p : { &segments[i].a, &segments[i].b }) {
+			bMin = ofVec3f(std::min(bMin.x, p->x), std::min(bMin.y, p->y), std::min(bMin.z, p->z));
+			bMax = ofVec3f(std::max(bMax.x, p->x), std::max(bMax.y, p->y), std::max(bMax.z, p->z));
+		}
+	}
+
+	nodes[nodeIndex].min = bMin;
+	nodes[nodeIndex].max = bMax;
+
+	if (count <= krlPickLeafSize) {
+		nodes[nodeIndex].first = first;
+		nodes[nodeIndex].count = count;
+		return;
+	}
+
+	//Median split on the longest axis of the box
+	ofVec3f extent = bMax - bMin;
+	int axis = extent.x > extent.y ? (extent.x > extent.z ? 0 : 2) : (extent.y > extent.z ? 1 : 2);
+	uint32_t half = count / 2;
+
+	std::nth_element(segments.begin() + first, segments.begin() + first + half, segments.begin() + first + count,
+		[axis](const segment& l, const segment& r) { return l.a[axis] + l.b[axis] < r.a[axis] + r.b[axis]; });
+
+	uint32_t left = nodes.size();
+	nodes.push_back(node());
+	nodes.push_back(node());
+
+	nodes[nodeIndex].first = left;
+	nodes[nodeIndex].count = 0;
+
+	buildNode(left, first, half);
+	buildNode(left + 1, first + half, count - half);
+
+}
+
+int krlPickIndex::pick(const ofVec3f& origin, const ofVec3f& dir, float length, float radius, float radiusSlope) const {
+
+	if (nodes.empty()) {
+		return -1;
+	}
+
+	int bestMove = -1;
+	float bestS = length;
+
+	std::vector<uint32_t> stack;
+	stack.reserve(64);
+	stack.push_back(0);
+
+	while (!stack.empty()) {
+
+		const node& n = nodes[stack.back()];
+		stack.pop_back();
+
+		//Conservative test of the box as its bounding sphere against the widening pick cone
+		ofVec3f center = (n.min + n.max) * 0.5f;
+		float sphere = (n.max - n.min).length() * 0.5f;
+		float s = (center - origin).dot(dir);
+		float d = (center - origin - dir * s).length();
+
+		if (s + sphere < 0 || s - sphere > bestS || d - sphere > radius + radiusSlope * (s + sphere)) {
+			continue;
+		}
+
+		if (n.count == 0) {
+
+			//Visit the nearer child first, it likely tightens bestS for the other
+			const node& l = nodes[n.first];
+			const node& r = nodes[n.first + 1];
+			float sl = ((l.min + l.max) * 0.5f - origin).dot(dir);
+			float sr = ((r.min + r.max) * 0.5f - origin).dot(dir);
+
+			stack.push_back(sl < sr ? n.first + 1 : n.first);
+			stack.push_back(sl < sr ? n.first : n.first + 1);
+			continue;
+		}
+
+		for (uint32_t i = n.first; i < n.first + n.count; i++) {
+
+			//Closest points between the ray line and the segment
+			const segment& seg = segments[i];
+			ofVec3f u = seg.b - seg.a;
+			ofVec3f w = origin - seg.a;
+			float uu = u.dot(u);
+			float ud = u.dot(dir);
+			float denom = uu - ud * ud;
+
+			float t = 0;
+			if (uu > 0) {
+				t = denom > 1e-9f ? (u.dot(w) - ud * dir.dot(w)) / denom : 0;
+				t = ofClamp(t, 0, 1);
+			}
+
+			ofVec3f p = seg.a + u * t;
+			float ps = (p - origin).dot(dir);
+			float pd = (p - origin - dir * ps).length();
+
+			if (ps >= 0 && ps < bestS && pd <= radius + radiusSlope * ps) {
+				bestS = ps;
+				bestMove = seg.move;
+			}
+		}
+
+	}
+
+	return bestMove;
+}
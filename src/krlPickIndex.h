@@ -0,0 +1,41 @@
+#pragma once
+
+#include "ofMain.h"
+#include "krlConverter.h"
+
+//Bounding volume hierarchy over the toolpath segments, for picking a move with the mouse in the preview.
+//Works in slicer coordinates, same as guiPoly. CIRC moves are indexed as the two chords through their
+//auxiliary point, close enough to the drawn arc for picking.
+class krlPickIndex {
+
+	public:
+		void build(const std::vector<krlMove>& toolpath);
+		void clear();
+		bool empty() const;
+
+		//Move closest to the camera along the ray origin + dir * s (s in [0, length]) whose distance to
+		//the ray is within radius + radiusSlope * s, the slope widens the tolerance with depth so it stays
+		//a constant number of pixels on screen. Returns -1 when nothing is hit.
+		int pick(const ofVec3f& origin, const ofVec3f& dir, float length, float radius, float radiusSlope) const;
+
+	private:
+		struct segment {
+			ofVec3f a;
+			ofVec3f b;
+			uint32_t move;
+		};
+
+		//Leaf when count > 0, otherwise first is the left child and first + 1 the right child
+		struct node {
+			ofVec3f min;
+			ofVec3f max;
+			uint32_t first;
+			uint32_t count;
+		};
+
+		void buildNode(uint32_t nodeIndex, uint32_t first, uint32_t count);
+
+		std::vector<segment> segments;
+		std::vector<node> nodes;
+
+};
@@ -0,0 +1,429 @@
+#include "krlStream.h"
+
+//EKI channel name, also the name of the configuration file on the controller
+static const std::string krlStreamChannel = "OfStream";
+
+//Read the integer value of attribute `name` from a tag, -1 when missing
+static int krlStreamAttribute(const std::string& tag, const std::string& name) {
+
+	size_t pos = tag.find(" " + name + "=\"");
+	if (pos == std::string::npos) {
+		return -1;
+	}
+
+	return ofToInt(tag.substr(pos + name.size() + 3));
+}
+
+static float krlStreamFloatAttribute(const std::string& tag, const std::string& name) {
+
+	size_t pos = tag.find(" " + name + "=\"");
+	if (pos == std::string::npos) {
+		return 0;
+	}
+
+	return ofToFloat(tag.substr(pos + name.size() + 3));
+}
+
+krlStreamer::krlStreamer(const krlConversion& conv, const std::string& host, int port, unsigned int window, unsigned int batch)
+	: records(conv.toolpathBuffer), host(host), port(port), window(std::max(1u, window)), batch(std::max(1u, batch)),
+	sent(0), acked(0), connected(false), finished(false), firstAckMillis(0), startMillis(0) {
+
+	//Bake the placement in once, the thread only formats
+	krlPlaceToolpath(records, krlMakePlacement(conv.settings));
+
+}
+
+krlStreamer::~krlStreamer() {
+	stop();
+}
+
+void krlStreamer::start() {
+	startMillis = ofGetElapsedTimeMillis();
+	startThread();
+}
+
+void krlStreamer::stop() {
+	if (isThreadRunning()) {
+		waitForThread(true);
+	}
+}
+
+std::string krlStreamer::getStatus() {
+
+	std::string status = "Stream: ";
+
+	if (finished) {
+		status += "done, ";
+	}
+	else if (!connected) {
+		status += "connecting to " + host + ":" + ofToString(port) + ", ";
+	}
+
+	status += ofToString(acked.load()) + "/" + ofToString(records.size()) + " acked, " + ofToString(sent.load() - acked.load()) + " in flight";
+
+	if (firstAckMillis > 0) {
+		status += ", first move after " + ofToString(firstAckMillis.load() - startMillis) + " ms";
+	}
+
+	return status;
+}
+
+std::string krlStreamer::formatRecord(uint32_t seq) const {
+
+	const krlMove& move = records[seq];
+
+	return "<Stream><M N=\"" + ofToString(seq) + "\" T=\"" + ofToString(int(move.type)) + "\" E=\"" + ofToString(int(move.extruding))
+		+ "\" X=\"" + ofToString(move.target.x, 2) + "\" Y=\"" + ofToString(move.target.y, 2) + "\" Z=\"" + ofToString(move.target.z, 2)
+		+ "\" AX=\"" + ofToString(move.aux.x, 2) + "\" AY=\"" + ofToString(move.aux.y, 2) + "\" AZ=\"" + ofToString(move.aux.z, 2) + "\"/></Stream>";
+}
+
+void krlStreamer::threadedFunction() {
+
+	ofxTCPClient client;
+
+	while (isThreadRunning() && !client.setup(host, port, false)) {
+		std::cout << "Stream: no controller at " << host << ":" << port << ", retrying" << std::endl;
+		ofSleepMillis(1000);
+	}
+
+	if (!isThreadRunning()) {
+		return;
+	}
+
+	connected = true;
+	std::cout << "Stream: connected to " << host << ":" << port << ", " << records.size() << " moves, window " << window << std::endl;
+
+	std::string ackBuffer;
+	bool endSent = false;
+
+	while (isThreadRunning()) {
+
+		if (!client.isConnected()) {
+			std::cout << "Stream: connection lost after " << acked.load() << " acked moves" << std::endl;
+			break;
+		}
+
+		//Collect acks, N is the sequence number the controller just took from its buffer
+		ackBuffer += client.receiveRaw();
+		size_t tagEnd;
+		while ((tagEnd = ackBuffer.find("/>")) != std::string::npos) {
+
+			int seq = krlStreamAttribute(ackBuffer.substr(0, tagEnd), "N");
+			if (seq >= 0 && uint32_t(seq) + 1 > acked) {
+				acked = seq + 1;
+				if (firstAckMillis == 0) firstAckMillis = ofGetElapsedTimeMillis();
+			}
+
+			ackBuffer.erase(0, tagEnd + 2);
+		}
+
+		uint32_t s = sent;
+		uint32_t inFlight = s - acked;
+		bool idle = true;
+
+		//Send a batch when the window has room for it, or the tail of the program
+		if (s < records.size() && window - inFlight >= std::min<uint32_t>(batch, records.size() - s)) {
+
+			uint32_t count = std::min<uint32_t>(window - inFlight, std::min<uint32_t>(batch, records.size() - s));
+
+			std::string message;
+			for (uint32_t i = s; i < s + count; i++) {
+				message += formatRecord(i);
+			}
+
+			client.sendRaw(message);
+			sent = s + count;
+			idle = false;
+
+		}
+		else if (s == records.size() && !endSent) {
+
+			//Negative sequence number ends the interpreter loop
+			client.sendRaw("<Stream><M N=\"-1\" T=\"0\" E=\"0\" X=\"0\" Y=\"0\" Z=\"0\" AX=\"0\" AY=\"0\" AZ=\"0\"/></Stream>");
+			endSent = true;
+
+		}
+
+		if (endSent && acked == records.size()) {
+			finished = true;
+			std::cout << "Stream: all " << records.size() << " moves acked in " << ofGetElapsedTimeMillis() - startMillis << " ms" << std::endl;
+			break;
+		}
+
+		if (idle) {
+			ofSleepMillis(1);
+		}
+
+	}
+
+	client.close();
+
+}
+
+krlStreamSimulator::krlStreamSimulator(int port, unsigned int bufferLimit, unsigned int advance, float speed, float minMoveMs)
+	: port(port), bufferLimit(bufferLimit), advance(std::max(1u, advance)), speed(speed), minMoveMs(minMoveMs),
+	consumed(0), bufferFill(0), maxFill(0), overflows(0), starvations(0), done(false) {
+}
+
+krlStreamSimulator::~krlStreamSimulator() {
+	stop();
+}
+
+void krlStreamSimulator::start() {
+	startThread();
+}
+
+void krlStreamSimulator::stop() {
+	if (isThreadRunning()) {
+		waitForThread(true);
+	}
+}
+
+std::string krlStreamSimulator::getStatus() {
+	return "Simulator: " + ofToString(consumed.load()) + " moves, buffer " + ofToString(bufferFill.load()) + "/" + ofToString(bufferLimit)
+		+ " (max " + ofToString(maxFill.load()) + "), " + ofToString(overflows.load()) + " overflows, " + ofToString(starvations.load()) + " starvations"
+		+ (done ? ", end of stream" : "");
+}
+
+void krlStreamSimulator::threadedFunction() {
+
+	ofxTCPServer server;
+
+	if (!server.setup(port, false)) {
+		std::cout << "Simulator: could not listen on port " << port << std::endl;
+		return;
+	}
+
+	std::cout << "Simulator: listening on port " << port << ", EKI buffer " << bufferLimit << ", advance " << advance << ", " << speed << " m/s" << std::endl;
+
+	std::string inBuffer;
+	std::deque<std::string> fifo;
+	std::deque<ofVec3f> planned;
+	ofVec3f position;
+	bool started = false;
+	bool moving = false;
+	bool endReceived = false;
+	uint64_t busyUntil = 0;
+	float mmPerMs = std::max(speed, 0.001f);	//m/s is mm/ms
+
+	while (isThreadRunning()) {
+
+		int clientId = -1;
+		for (int i = 0; i < server.getLastID(); i++) {
+			if (server.isClientConnected(i)) clientId = i;
+		}
+
+		if (clientId < 0) {
+			ofSleepMillis(10);
+			continue;
+		}
+
+		//Every complete <Stream> record goes into the FIFO like the EKI buffer
+		inBuffer += server.receiveRaw(clientId);
+		size_t recordEnd;
+		while ((recordEnd = inBuffer.find("</Stream>")) != std::string::npos) {
+
+			fifo.push_back(inBuffer.substr(0, recordEnd));
+			inBuffer.erase(0, recordEnd + 9);
+
+			if (fifo.size() > bufferLimit) {
+				overflows++;
+			}
+		}
+
+		maxFill = std::max<uint32_t>(maxFill, fifo.size());
+
+		//The interpreter runs ahead of the robot in the advance run, it takes and acks records while the planner has room
+		while (!fifo.empty() && planned.size() < advance && !endReceived) {
+
+			std::string record = fifo.front();
+			fifo.pop_front();
+
+			int seq = krlStreamAttribute(record, "N");
+
+			if (seq < 0) {
+				endReceived = true;
+				break;
+			}
+
+			planned.push_back(ofVec3f(krlStreamFloatAttribute(record, "X"), krlStreamFloatAttribute(record, "Y"), krlStreamFloatAttribute(record, "Z")));
+
+			std::string ack = "<Ack N=\"" + ofToString(seq) + "\" />";
+			server.sendRawBytes(clientId, ack.c_str(), ack.size());
+		}
+
+		bufferFill = fifo.size();
+
+		uint64_t now = ofGetElapsedTimeMillis();
+		if (moving && now < busyUntil) {
+			ofSleepMillis(1);
+			continue;
+		}
+
+		if (planned.empty()) {
+
+			//The move just finished had nothing to blend into, a real robot stops on the path here
+			if (moving && !endReceived) {
+				starvations++;
+			}
+
+			if (moving && endReceived && !done) {
+				done = true;
+				std::cout << "Simulator: end of stream after " << consumed.load() << " moves, max buffer " << maxFill.load() << ", " << overflows.load() << " overflows, " << starvations.load() << " starvations" << std::endl;
+			}
+
+			moving = false;
+
+			ofSleepMillis(1);
+			continue;
+		}
+
+		ofVec3f target = planned.front();
+		planned.pop_front();
+
+		float length = started ? position.distance(target) : 0;
+
+		busyUntil = now + std::max(minMoveMs, length / mmPerMs);
+		position = target;
+		started = true;
+		moving = true;
+		consumed++;
+
+	}
+
+	server.close();
+
+}
+
+std::vector<std::string> krlCompileStreamInterpreter(const krlSettings& settings, const std::string& programName) {
+
+	std::vector<std::string> krlOutput;
+
+	krlAppendProgramHeader(krlOutput, settings);
+
+	krlOutput[0] = "DEF " + programName + "()";
+	krlOutput.insert(krlOutput.begin() + 1, {
+		"DECL EKI_STATUS RET",
+		"DECL INT SEQ, MTYPE, EXT, LAST_EXT",
+		"DECL REAL RX, RY, RZ, RAX, RAY, RAZ",
+		"DECL E6POS P, AUX"
+	});
+
+	krlOutput.push_back("P = {X 0, Y 0, Z 0, A 0, B 90, C 0, E1 0, E2 0, E3 0, E4 0, S 'B 110'}");
+	krlOutput.push_back("AUX = P");
+	krlOutput.push_back("LAST_EXT = 0");
+	krlOutput.push_back("O_EXTRUDER_START = FALSE");
+	krlOutput.push_back("$FLAG[998] = FALSE");
+
+	krlOutput.push_back("RET = EKI_Init(\"" + krlStreamChannel + "\")");
+	krlOutput.push_back("RET = EKI_Open(\"" + krlStreamChannel + "\")");
+
+	krlOutput.push_back("LOOP");
+	krlOutput.push_back(";EKI sets flag 998 for every complete record in the buffer. CONTINUE keeps the waits and EKI calls");
+	krlOutput.push_back(";in the advance run, so it reads ahead of the robot and the moves blend with C_DIS.");
+	krlOutput.push_back("CONTINUE");
+	krlOutput.push_back("WAIT FOR $FLAG[998]");
+	krlOutput.push_back("CONTINUE");
+	krlOutput.push_back("RET = EKI_GetInt(\"" + krlStreamChannel + "\", \"Stream/M/@N\", SEQ)");
+	krlOutput.push_back("CONTINUE");
+	krlOutput.push_back("RET = EKI_GetInt(\"" + krlStreamChannel + "\", \"Stream/M/@T\", MTYPE)");
+	krlOutput.push_back("CONTINUE");
+	krlOutput.push_back("RET = EKI_GetInt(\"" + krlStreamChannel + "\", \"Stream/M/@E\", EXT)");
+	krlOutput.push_back("CONTINUE");
+	krlOutput.push_back("RET = EKI_GetReal(\"" + krlStreamChannel + "\", \"Stream/M/@X\", RX)");
+	krlOutput.push_back("CONTINUE");
+	krlOutput.push_back("RET = EKI_GetReal(\"" + krlStreamChannel + "\", \"Stream/M/@Y\", RY)");
+	krlOutput.push_back("CONTINUE");
+	krlOutput.push_back("RET = EKI_GetReal(\"" + krlStreamChannel + "\", \"Stream/M/@Z\", RZ)");
+	krlOutput.push_back("CONTINUE");
+	krlOutput.push_back("RET = EKI_GetReal(\"" + krlStreamChannel + "\", \"Stream/M/@AX\", RAX)");
+	krlOutput.push_back("CONTINUE");
+	krlOutput.push_back("RET = EKI_GetReal(\"" + krlStreamChannel + "\", \"Stream/M/@AY\", RAY)");
+	krlOutput.push_back("CONTINUE");
+	krlOutput.push_back("RET = EKI_GetReal(\"" + krlStreamChannel + "\", \"Stream/M/@AZ\", RAZ)");
+	krlOutput.push_back("IF RET.Buff == 0 THEN");
+	krlOutput.push_back("CONTINUE");
+	krlOutput.push_back("$FLAG[998] = FALSE");
+	krlOutput.push_back("ENDIF");
+	krlOutput.push_back("IF SEQ < 0 THEN");
+	krlOutput.push_back("EXIT");
+	krlOutput.push_back("ENDIF");
+
+	krlOutput.push_back("CONTINUE");
+	krlOutput.push_back("RET = EKI_SetInt(\"" + krlStreamChannel + "\", \"Ack/@N\", SEQ)");
+	krlOutput.push_back("CONTINUE");
+	krlOutput.push_back("RET = EKI_Send(\"" + krlStreamChannel + "\", \"Ack\")");
+
+	krlOutput.push_back("P.X = RX");
+	krlOutput.push_back("P.Y = RY");
+	krlOutput.push_back("P.Z = RZ");
+
+	krlOutput.push_back("IF EXT <> LAST_EXT THEN");
+	krlOutput.push_back("IF EXT == 1 THEN");
+	krlOutput.push_back("TRIGGER WHEN DISTANCE = 0 DELAY = 0 DO O_EXTRUDER_START = TRUE");
+	krlOutput.push_back("ELSE");
+	krlOutput.push_back("TRIGGER WHEN DISTANCE = 0 DELAY = 0 DO O_EXTRUDER_START = FALSE");
+	krlOutput.push_back("ENDIF");
+	krlOutput.push_back("LAST_EXT = EXT");
+	krlOutput.push_back("ENDIF");
+
+	krlOutput.push_back("SWITCH MTYPE");
+	krlOutput.push_back("CASE 0");
+	krlOutput.push_back("PTP P C_PTP");
+	krlOutput.push_back("CASE 1");
+	krlOutput.push_back("LIN P C_DIS");
+	krlOutput.push_back("CASE 2");
+	krlOutput.push_back("AUX.X = RAX");
+	krlOutput.push_back("AUX.Y = RAY");
+	krlOutput.push_back("AUX.Z = RAZ");
+	krlOutput.push_back("CIRC AUX, P C_DIS");
+	krlOutput.push_back("ENDSWITCH");
+	krlOutput.push_back("ENDLOOP");
+
+	krlOutput.push_back("O_EXTRUDER_START = FALSE");
+	krlOutput.push_back("RET = EKI_Close(\"" + krlStreamChannel + "\")");
+	krlOutput.push_back("RET = EKI_Clear(\"" + krlStreamChannel + "\")");
+	krlOutput.push_back("END");
+
+	return krlOutput;
+}
+
+std::vector<std::string> krlCompileStreamConfig(const std::string& controllerIp, int port, unsigned int bufferLimit) {
+
+	std::vector<std::string> config;
+
+	config.push_back("<ETHERNETKRL>");
+	config.push_back("	<CONFIGURATION>");
+	config.push_back("		<EXTERNAL>");
+	config.push_back("			<TYPE>Client</TYPE>");
+	config.push_back("		</EXTERNAL>");
+	config.push_back("		<INTERNAL>");
+	config.push_back("			<ENVIRONMENT>Program</ENVIRONMENT>");
+	config.push_back("			<BUFFERING Mode=\"FIFO\" Limit=\"" + ofToString(bufferLimit) + "\" />");
+	config.push_back("			<IP>" + controllerIp + "</IP>");
+	config.push_back("			<PORT>" + ofToString(port) + "</PORT>");
+	config.push_back("			<PROTOCOL>TCP</PROTOCOL>");
+	config.push_back("		</INTERNAL>");
+	config.push_back("	</CONFIGURATION>");
+	config.push_back("	<RECEIVE>");
+	config.push_back("		<XML>");
+
+	for (std::string attribute : { "N", "T", "E" }) {
+		config.push_back("			<ELEMENT Tag=\"Stream/M/@" + attribute + "\" Type=\"INT\" />");
+	}
+	for (std::string attribute : { "X", "Y", "Z", "AX", "AY", "AZ" }) {
+		config.push_back("			<ELEMENT Tag=\"Stream/M/@" + attribute + "\" Type=\"REAL\" />");
+	}
+
+	config.push_back("			<ELEMENT Tag=\"Stream\" Set_Flag=\"998\" />");
+	config.push_back("		</XML>");
+	config.push_back("	</RECEIVE>");
+	config.push_back("	<SEND>");
+	config.push_back("		<XML>");
+	config.push_back("			<ELEMENT Tag=\"Ack/@N\" />");
+	config.push_back("		</XML>");
+	config.push_back("	</SEND>");
+	config.push_back("</ETHERNETKRL>");
+
+	return config;
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include "ofMain.h"
+#include "ofxNetwork.h"
+#include "krlConverter.h"
+
+//EKI FIFO size configured on the controller, the streaming window must stay below it
+static const unsigned int krlStreamBufferLimit = 512;
+
+//Streaming backend: instead of writing a complete program, the toolpath is sent over TCP as EKI XML records
+//(<Stream><M N T E X Y Z AX AY AZ/></Stream>) to a small interpreter program on the controller. That
+//program acks every record it takes out of its EKI buffer with <Ack N/>. The streamer keeps at most
+//`window` records unacknowledged, so the window has to stay below the EKI buffer limit.
+class krlStreamer : public ofThread {
+
+	public:
+		//Streams conv.toolpathBuffer placed with conv.settings, the same positions as the emitted code
+		krlStreamer(const krlConversion& conv, const std::string& host, int port, unsigned int window, unsigned int batch);
+		~krlStreamer();
+
+		void start();
+		void stop();
+
+		std::string getStatus();
+
+	protected:
+		void threadedFunction();
+
+	private:
+		std::string formatRecord(uint32_t seq) const;
+
+		std::vector<krlMove> records;
+		std::string host;
+		int port;
+		unsigned int window;
+		unsigned int batch;
+
+		std::atomic<uint32_t> sent;
+		std::atomic<uint32_t> acked;
+		std::atomic<bool> connected;
+		std::atomic<bool> finished;
+		std::atomic<uint64_t> firstAckMillis;
+		uint64_t startMillis;
+
+};
+
+//Local stand-in for the controller. Accepts a streamer and buffers records like the EKI FIFO. The interpreter
+//takes records out of the buffer (and acks them) in the advance run, at most `advance` motions ahead of the
+//robot. The robot moves them at path length / $VEL.CP, never faster than one move per minMoveMs. A move that
+//ends with nothing planned after it can't be blended, the robot stops on the path: that is a starvation.
+//Reports buffer fill, overflows of the EKI limit and starvations.
+class krlStreamSimulator : public ofThread {
+
+	public:
+		krlStreamSimulator(int port, unsigned int bufferLimit, unsigned int advance, float speed, float minMoveMs);
+		~krlStreamSimulator();
+
+		void start();
+		void stop();
+
+		std::string getStatus();
+
+	protected:
+		void threadedFunction();
+
+	private:
+		int port;
+		unsigned int bufferLimit;
+		unsigned int advance;
+		float speed;
+		float minMoveMs;
+
+		std::atomic<uint32_t> consumed;
+		std::atomic<uint32_t> bufferFill;
+		std::atomic<uint32_t> maxFill;
+		std::atomic<uint32_t> overflows;
+		std::atomic<uint32_t> starvations;
+		std::atomic<bool> done;
+
+};
+
+//Interpreter program for the controller, the DEF name is taken from the file name
+std::vector<std::string> krlCompileStreamInterpreter(const krlSettings& settings, const std::string& programName);
+
+//EthernetKRL channel configuration matching the interpreter, goes in Config/User/Common/EthernetKRL
+std::vector<std::string> krlCompileStreamConfig(const std::string& controllerIp, int port, unsigned int bufferLimit);
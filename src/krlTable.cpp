@@ -0,0 +1,121 @@
+#include "krlTable.h"
+
+//Record types in the OFMOVE arrays
+enum : int { krlTablePTP = 0, krlTableLIN = 1, krlTableAux = 2, krlTableCIRC = 3 };
+
+static std::string krlTableRecord(uint32_t chunk, uint32_t index, int type, bool extruding, const ofVec3f& p) {
+	return "M" + ofToString(chunk) + "[" + ofToString(index) + "]={T " + ofToString(type) + ",E " + (extruding ? "1" : "0")
+		+ ",X " + ofToString(p.x, 1) + ",Y " + ofToString(p.y, 1) + ",Z " + ofToString(p.z, 1) + "}";
+}
+
+void krlCompileTableProgram(const krlConversion& conv, const krlSettings& settings, const std::string& programName, unsigned int chunkSize,
+	std::vector<std::string>& src, std::vector<std::string>& dat) {
+
+	src.clear();
+	dat.clear();
+
+	chunkSize = std::max(1u, chunkSize);
+
+	std::vector<krlMove> placed = conv.toolpathBuffer;
+	krlPlaceToolpath(placed, krlMakePlacement(conv.settings));
+
+	//Records first, the array declarations need the chunk sizes
+	std::vector<std::string> records;
+	std::vector<uint32_t> chunkCounts;
+	records.reserve(conv.toolpathBuffer.size() + conv.midPointCollection.size());
+
+	auto addRecord = [&](int type, bool extruding, const ofVec3f& p) {
+
+		if (chunkCounts.empty() || chunkCounts.back() == chunkSize) {
+			chunkCounts.push_back(0);
+		}
+
+		chunkCounts.back()++;
+		records.push_back(krlTableRecord(chunkCounts.size(), chunkCounts.back(), type, extruding, p));
+	};
+
+	for (const krlMove& move : placed) {
+
+		if (move.type == krlMove::PTP) {
+			addRecord(krlTablePTP, move.extruding, move.target);
+		}
+		else if (move.type == krlMove::LIN) {
+			addRecord(krlTableLIN, move.extruding, move.target);
+		}
+		else {
+			addRecord(krlTableAux, move.extruding, move.aux);
+			addRecord(krlTableCIRC, move.extruding, move.target);
+		}
+
+	}
+
+	//Data list: record type, the state shared by all chunks and one array per chunk
+	dat.reserve(records.size() + chunkCounts.size() + 16);
+	dat.push_back("DEFDAT " + programName);
+	dat.push_back("STRUC OFMOVE INT T,E,REAL X,Y,Z");
+	//Status like the PTP lines of the full program, no turn so the controller keeps the axis configuration
+	dat.push_back("DECL E6POS OFP={X 0.0,Y 0.0,Z 0.0,A 0.0,B 90.0,C 0.0,S 6,E1 0.0,E2 0.0,E3 0.0,E4 0.0,E5 0.0,E6 0.0}");
+	dat.push_back("DECL E6POS OFAUX={X 0.0,Y 0.0,Z 0.0,A 0.0,B 90.0,C 0.0,S 6,E1 0.0,E2 0.0,E3 0.0,E4 0.0,E5 0.0,E6 0.0}");
+	dat.push_back("DECL INT OFEXT=0");
+
+	for (uint32_t c = 0; c < chunkCounts.size(); c++) {
+		dat.push_back("DECL OFMOVE M" + ofToString(c + 1) + "[" + ofToString(chunkCounts[c]) + "]");
+	}
+
+	dat.insert(dat.end(), records.begin(), records.end());
+	dat.push_back("ENDDAT");
+
+	//Program: the usual setup, one call per chunk and the loop that moves through a chunk
+	krlAppendProgramHeader(src, settings);
+	src[0] = "DEF " + programName + "()";
+
+	src.push_back("OFEXT = 0");
+	src.push_back("O_EXTRUDER_START = FALSE");
+
+	for (uint32_t c = 0; c < chunkCounts.size(); c++) {
+		src.push_back("OFCHUNK(M" + ofToString(c + 1) + "[], " + ofToString(chunkCounts[c]) + ")");
+	}
+
+	src.push_back("O_EXTRUDER_START = FALSE");
+	src.push_back("END");
+	src.push_back("");
+
+	src.push_back("DEF OFCHUNK(M[]:OUT, COUNT:IN)");
+	src.push_back("DECL OFMOVE M[]");
+	src.push_back("DECL INT COUNT, I");
+	src.push_back("FOR I = 1 TO COUNT");
+
+	//Only the aux point of a CIRC is kept, the move follows with the next record
+	src.push_back("IF M[I].T == 2 THEN");
+	src.push_back("OFAUX.X = M[I].X");
+	src.push_back("OFAUX.Y = M[I].Y");
+	src.push_back("OFAUX.Z = M[I].Z");
+	src.push_back("ELSE");
+
+	src.push_back("OFP.X = M[I].X");
+	src.push_back("OFP.Y = M[I].Y");
+	src.push_back("OFP.Z = M[I].Z");
+
+	src.push_back("IF M[I].E <> OFEXT THEN");
+	src.push_back("IF M[I].E == 1 THEN");
+	src.push_back("TRIGGER WHEN DISTANCE = 0 DELAY = 0 DO O_EXTRUDER_START = TRUE");
+	src.push_back("ELSE");
+	src.push_back("TRIGGER WHEN DISTANCE = 0 DELAY = 0 DO O_EXTRUDER_START = FALSE");
+	src.push_back("ENDIF");
+	src.push_back("OFEXT = M[I].E");
+	src.push_back("ENDIF");
+
+	src.push_back("SWITCH M[I].T");
+	src.push_back("CASE 0");
+	src.push_back("PTP OFP C_PTP");
+	src.push_back("CASE 1");
+	src.push_back("LIN OFP C_DIS");
+	src.push_back("CASE 3");
+	src.push_back("CIRC OFAUX, OFP C_DIS");
+	src.push_back("ENDSWITCH");
+
+	src.push_back("ENDIF");
+	src.push_back("ENDFOR");
+	src.push_back("END");
+
+}
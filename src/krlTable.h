@@ -0,0 +1,15 @@
+#pragma once
+
+#include "ofMain.h"
+#include "krlConverter.h"
+
+//Controllers refuse data lists with very large arrays, the toolpath is split over arrays of at most this many records
+static const unsigned int krlTableDefaultChunk = 5000;
+
+//Compact export: instead of one spelled-out motion line per move, the toolpath goes into typed arrays in the
+//companion .dat (one OFMOVE record per point, orientation and status declared once) and a small .src loops
+//over them. CIRC moves take two records, the auxiliary point (T 2) followed by the target (T 3).
+//Both programs are named after programName, which has to match the file names on the controller. Points are
+//placed with conv.settings like the emitted code, settings only feeds the program header.
+void krlCompileTableProgram(const krlConversion& conv, const krlSettings& settings, const std::string& programName, unsigned int chunkSize,
+	std::vector<std::string>& src, std::vector<std::string>& dat);
@@ -0,0 +1,161 @@
+#include "krlValidator.h"
+
+static std::string krlCheckPoint(const ofVec3f& p, const krlLimits& limits, const std::string& name) {
+
+	std::string reason;
+
+	if (!limits.workspace.inside(p)) {
+		reason += name + " outside workspace; ";
+	}
+
+	for (size_t b = 0; b < limits.keepOut.size(); b++) {
+		if (limits.keepOut[b].inside(p)) {
+			reason += name + " in keep-out box " + ofToString(b + 1) + "; ";
+		}
+	}
+
+	return reason;
+}
+
+//Checks against the arc of the gcode, in slicer XY where G2/G3 and I/J are defined. The midpoint of the arc
+//turning the wrong way lies on the same circle and is as far from start as from target, only the center and
+//the turn direction tell them apart. The placement is rigid, so this holds for the placed arc as well.
+static std::string krlCheckArc(const ofVec3f& start, const krlMove& move, const krlLimits& limits) {
+
+	std::string reason;
+
+	ofVec2f center = ofVec2f(move.center.x, move.center.y);
+	float radius = ofVec2f(start.x, start.y).distance(center);
+
+	float targetOff = std::abs(ofVec2f(move.target.x, move.target.y).distance(center) - radius);
+	if (targetOff > limits.maxMidpointDeviation) {
+		reason += "target " + ofToString(targetOff, 1) + " mm off the I/J circle; ";
+	}
+
+	float auxOff = std::abs(ofVec2f(move.aux.x, move.aux.y).distance(center) - radius);
+	if (auxOff > limits.maxMidpointDeviation) {
+		reason += "aux point " + ofToString(auxOff, 1) + " mm off the I/J circle; ";
+	}
+
+	//Start, aux and target in order along the arc turn the same way as the arc itself
+	ofVec3f a = move.aux - start;
+	ofVec3f b = move.target - move.aux;
+	float turn = a.x * b.y - a.y * b.x;
+
+	if (turn != 0 && (turn < 0) != bool(move.clockwise)) {
+		reason += std::string("aux point on the ") + (move.clockwise ? "G3" : "G2") + " side of a " + (move.clockwise ? "G2" : "G3") + " arc; ";
+	}
+
+	return reason;
+}
+
+static void krlValidateRange(const std::vector<krlMove>& toolpath, const krlPlacement& placement, const krlLimits& limits,
+	uint32_t first, uint32_t last, std::vector<krlViolation>& violations) {
+
+	for (uint32_t i = first; i < last; i++) {
+
+		const krlMove& move = toolpath[i];
+		ofVec3f target = placement.apply(move.target);
+
+		std::string reason = krlCheckPoint(target, limits, "target");
+
+		if (move.type == krlMove::CIRC) {
+
+			ofVec3f aux = placement.apply(move.aux);
+			reason += krlCheckPoint(aux, limits, "aux point");
+
+			//An arc needs a start, the very first move has none
+			if (i > 0) {
+
+				ofVec3f start = placement.apply(toolpath[i - 1].target);
+
+				//Radius of the circle through start, aux and target
+				ofVec3f a = aux - start;
+				ofVec3f b = target - start;
+				float area = a.getCrossed(b).length();
+
+				if (area < 1e-6f) {
+					reason += "arc points on one line; ";
+				}
+				else {
+					float radius = a.length() * b.length() * (a - b).length() / (2 * area);
+					if (radius > limits.maxArcRadius) {
+						reason += "arc radius " + ofToString(radius, 0) + " mm; ";
+					}
+				}
+
+				//On a real arc the midpoint is as far from the start as from the target
+				float deviation = std::abs(aux.distance(start) - aux.distance(target)) * 0.5f;
+				if (deviation > limits.maxMidpointDeviation) {
+					reason += "aux point " + ofToString(deviation, 1) + " mm off the arc middle; ";
+				}
+
+				reason += krlCheckArc(toolpath[i - 1].target, move, limits);
+			}
+		}
+
+		if (!reason.empty()) {
+			reason.resize(reason.size() - 2);
+			violations.push_back({ i, reason });
+		}
+	}
+
+}
+
+std::vector<krlViolation> krlValidateToolpath(const krlConversion& conv, const krlLimits& limits, unsigned int threadCount) {
+
+	const std::vector<krlMove>& toolpath = conv.toolpathBuffer;
+	krlPlacement placement = krlMakePlacement(conv.settings);
+
+	//Contiguous ranges per thread, results are joined in order so the list stays sorted by move
+	threadCount = std::max<size_t>(1, std::min<size_t>(threadCount, toolpath.size() / 10000 + 1));
+	uint32_t rangeSize = (toolpath.size() + threadCount - 1) / threadCount;
+
+	std::vector<std::vector<krlViolation>> results(threadCount);
+	std::vector<std::thread> threads;
+
+	for (unsigned int t = 0; t < threadCount; t++) {
+
+		uint32_t first = std::min<size_t>(t * rangeSize, toolpath.size());
+		uint32_t last = std::min<size_t>(first + rangeSize, toolpath.size());
+
+		threads.emplace_back(krlValidateRange, std::cref(toolpath), std::cref(placement), std::cref(limits), first, last, std::ref(results[t]));
+	}
+
+	std::vector<krlViolation> violations;
+
+	for (unsigned int t = 0; t < threadCount; t++) {
+		threads[t].join();
+		violations.insert(violations.end(), results[t].begin(), results[t].end());
+	}
+
+	return violations;
+}
+
+bool krlLoadKeepOut(const std::string& xmlPath, std::vector<krlBox>& boxes) {
+
+	boxes.clear();
+
+	ofXml xml;
+	if (!xml.load(xmlPath)) {
+		return false;
+	}
+
+	for (auto box : xml.getChild("KeepOut").getChildren("Box")) {
+
+		std::vector<std::string> bMin = ofSplitString(box.getAttribute("min").getValue(), ",", true, true);
+		std::vector<std::string> bMax = ofSplitString(box.getAttribute("max").getValue(), ",", true, true);
+
+		if (bMin.size() != 3 || bMax.size() != 3) {
+			std::cout << "Skipping keep-out box without min and max in " << xmlPath << std::endl;
+			continue;
+		}
+
+		krlBox b;
+		b.min = ofVec3f(ofToFloat(bMin[0]), ofToFloat(bMin[1]), ofToFloat(bMin[2]));
+		b.max = ofVec3f(ofToFloat(bMax[0]), ofToFloat(bMax[1]), ofToFloat(bMax[2]));
+		boxes.push_back(b);
+	}
+
+	return true;
+}
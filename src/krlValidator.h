@@ -0,0 +1,34 @@
+#pragma once
+
+#include "ofMain.h"
+#include "krlConverter.h"
+
+//Axis aligned box in the robot base frame
+struct krlBox {
+	ofVec3f min;
+	ofVec3f max;
+
+	bool inside(const ofVec3f& p) const {
+		return p.x >= min.x && p.x <= max.x && p.y >= min.y && p.y <= max.y && p.z >= min.z && p.z <= max.z;
+	}
+};
+
+//What the placed toolpath is checked against before it goes to the robot
+struct krlLimits {
+	krlBox workspace;				//Every target and aux point has to be inside
+	std::vector<krlBox> keepOut;	//No target or aux point may be inside
+	float maxArcRadius;				//Larger arcs are nearly straight, the controller plans them badly
+	float maxMidpointDeviation;		//How far the aux point and target may be off the arc the gcode describes
+};
+
+//Move that breaks one or more limits, moves come out in toolpath order
+struct krlViolation {
+	uint32_t move;
+	std::string reason;
+};
+
+//Check every PTP/LIN/CIRC target and CIRC aux point placed with conv.settings, split over threadCount threads
+std::vector<krlViolation> krlValidateToolpath(const krlConversion& conv, const krlLimits& limits, unsigned int threadCount);
+
+//Keep-out boxes from an xml file: <KeepOut><Box min="x, y, z" max="x, y, z"/>...</KeepOut>
+bool krlLoadKeepOut(const std::string& xmlPath, std::vector<krlBox>& boxes);
@@ -0,0 +1,312 @@
+#include "krlWatchService.h"
+
+#ifdef TARGET_LINUX
+#include <sys/inotify.h>
+#include <poll.h>
+#include <unistd.h>
+#endif
+
+static bool krlIsGCodeFile(const std::string& fileName) {
+	return ofToLower(ofFilePath::getFileExt(fileName)) == "gcode";
+}
+
+static std::string krlSrcName(const std::string& fileName) {
+	return krlSanitizeSavePath(ofFilePath::getBaseName(fileName) + ".src");
+}
+
+krlWatchWorker::krlWatchWorker(krlWatchService& service) : service(service) {
+}
+
+void krlWatchWorker::threadedFunction() {
+
+	//receive() blocks until a file is queued, returns false once the queue is closed
+	std::string fileName;
+	while (service.queue.receive(fileName)) {
+		service.convertFile(fileName);
+	}
+
+}
+
+krlWatchService::krlWatchService(const std::string& inputDir, const std::string& outputDir, const krlSettings& defaults, unsigned int workerCount)
+	: inputDir(ofToDataPath(inputDir, true)), outputDir(ofToDataPath(outputDir, true)), defaults(defaults),
+	watchFd(-1), partCounter(0), queued(0), converted(0), failed(0) {
+
+	workerCount = std::max(1u, workerCount);
+
+	for (unsigned int i = 0; i < workerCount; i++) {
+		workers.push_back(std::make_unique<krlWatchWorker>(*this));
+	}
+
+}
+
+krlWatchService::~krlWatchService() {
+	stop();
+}
+
+void krlWatchService::start() {
+
+	std::cout << "Watch service: " << inputDir << " -> " << outputDir << " on " << workers.size() << " workers" << std::endl;
+
+	ofDirectory::createDirectory(inputDir, false, true);
+	ofDirectory::createDirectory(outputDir, false, true);
+
+	for (auto& worker : workers) {
+		worker->startThread();
+	}
+
+	//Watch before listing, a file that lands in between is then seen twice instead of not at all
+	openWatch();
+	enqueueExisting();
+	startThread();
+
+}
+
+void krlWatchService::stop() {
+
+	//Stop watching first, then close the queue. Workers finish the file they are on, files still queued
+	//have no .src yet and are picked up again on the next start.
+	if (isThreadRunning()) {
+		waitForThread(true);
+	}
+
+	queue.close();
+
+	for (auto& worker : workers) {
+		if (worker->isThreadRunning()) {
+			worker->waitForThread(false);
+		}
+	}
+
+}
+
+std::string krlWatchService::getStatus() {
+	return "Watch service: " + ofToString(converted.load()) + " converted, " + ofToString(failed.load()) + " failed, " + ofToString(queued.load()) + " queued";
+}
+
+void krlWatchService::enqueue(const std::string& fileName) {
+
+	if (!krlIsGCodeFile(fileName)) {
+		return;
+	}
+
+	std::unique_lock<std::mutex> lock(pendingMutex);
+
+	auto file = pending.find(fileName);
+	if (file != pending.end()) {
+		//Already queued, or written again while converting: convert once more when that is done
+		if (file->second == pendingConverting) {
+			file->second = pendingChanged;
+		}
+		return;
+	}
+
+	pending[fileName] = pendingQueued;
+	queued++;
+	queue.send(fileName);
+
+}
+
+void krlWatchService::enqueueExisting() {
+
+	//Pick up files that were dropped while the service wasn't running
+	ofDirectory dir(inputDir);
+	dir.allowExt("gcode");
+	dir.listDir();
+
+	for (size_t i = 0; i < dir.size(); i++) {
+
+		if (!ofFile::doesFileExist(ofFilePath::join(outputDir, krlSrcName(dir.getName(i))), false)) {
+			enqueue(dir.getName(i));
+		}
+
+	}
+
+}
+
+void krlWatchService::threadedFunction() {
+
+	if (watchFd >= 0) {
+		watchInotify();
+	}
+	else {
+		watchPolling();
+	}
+
+}
+
+#ifdef TARGET_LINUX
+void krlWatchService::openWatch() {
+
+	watchFd = inotify_init1(IN_NONBLOCK);
+
+	//Close-write catches files written in place, moved-to catches slicers that write a temp file and rename
+	if (watchFd < 0 || inotify_add_watch(watchFd, inputDir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+
+		std::cout << "Watch service: inotify unavailable for " << inputDir << ", falling back to polling" << std::endl;
+		if (watchFd >= 0) close(watchFd);
+
+		watchFd = -1;
+	}
+
+}
+
+void krlWatchService::watchInotify() {
+
+	int fd = watchFd;
+	alignas(inotify_event) char events[4096];
+
+	while (isThreadRunning()) {
+
+		//Wake up regularly to check if we should stop
+		pollfd pfd = { fd, POLLIN, 0 };
+		if (poll(&pfd, 1, 250) <= 0) {
+			continue;
+		}
+
+		ssize_t length = read(fd, events, sizeof(events));
+
+		for (char* p = events; length > 0 && p < events + length; ) {
+
+			const inotify_event* event = reinterpret_cast<const inotify_event*>(p);
+
+			if (event->len > 0 && !(event->mask & IN_ISDIR)) {
+				enqueue(event->name);
+			}
+
+			p += sizeof(inotify_event) + event->len;
+		}
+
+	}
+
+	close(fd);
+	watchFd = -1;
+
+}
+#else
+void krlWatchService::openWatch() {
+	watchFd = -1;
+}
+
+void krlWatchService::watchInotify() {
+	watchPolling();
+}
+#endif
+
+void krlWatchService::watchPolling() {
+
+	//A file is picked up once its size stayed the same over two scans, so half-written files are skipped.
+	//Files with a .src already count as handled, the rest goes through the scans (enqueueExisting may
+	//have queued them already, enqueue() drops the duplicate).
+	std::map<std::string, uint64_t> lastSize;
+	std::map<std::string, uint64_t> handledSize;
+
+	ofDirectory dir(inputDir);
+	dir.allowExt("gcode");
+	dir.listDir();
+
+	for (size_t i = 0; i < dir.size(); i++) {
+		if (ofFile::doesFileExist(ofFilePath::join(outputDir, krlSrcName(dir.getName(i))), false)) {
+			handledSize[dir.getName(i)] = dir.getFile(i).getSize();
+		}
+	}
+
+	while (isThreadRunning()) {
+
+		dir.listDir();
+
+		for (size_t i = 0; i < dir.size(); i++) {
+
+			std::string name = dir.getName(i);
+			uint64_t size = dir.getFile(i).getSize();
+
+			auto handled = handledSize.find(name);
+			if (handled != handledSize.end() && handled->second == size) {
+				continue;
+			}
+
+			auto last = lastSize.find(name);
+			if (last != lastSize.end() && last->second == size && size > 0) {
+				handledSize[name] = size;
+				enqueue(name);
+			}
+
+			lastSize[name] = size;
+		}
+
+		ofSleepMillis(1000);
+	}
+
+}
+
+void krlWatchService::convertFile(const std::string& fileName) {
+
+	{
+		std::unique_lock<std::mutex> lock(pendingMutex);
+		pending[fileName] = pendingConverting;
+	}
+
+	uint64_t startTime = ofGetElapsedTimeMillis();
+	std::string inPath = ofFilePath::join(inputDir, fileName);
+	std::string baseName = ofFilePath::getBaseName(fileName);
+
+	//Per-file sidecar overrides the service defaults
+	krlSettings settings = defaults;
+	std::string sidecarPath = ofFilePath::join(inputDir, baseName + ".xml");
+	bool hasSidecar = ofFile::doesFileExist(sidecarPath, false) && krlLoadSettings(sidecarPath, settings);
+
+	std::string outPath = ofFilePath::join(outputDir, krlSrcName(fileName));
+	std::string log;
+
+	try {
+
+		ofBuffer cBuf = ofBufferFromFile(inPath);
+		if (cBuf.size() == 0) {
+			throw std::runtime_error("empty or unreadable file");
+		}
+
+		std::vector<std::string> gCode = krlFilterGCode(cBuf, false);
+
+		krlConversion conv;
+		krlParseGCode(gCode, conv, false);
+		krlEmitCode(conv, settings);
+
+		//Write next to the target and rename, so nobody picks up a half written program. The part name is
+		//unique, two inputs can sanitize to the same .src.
+		std::string partPath = outPath + "." + ofToString(partCounter++) + ".part";
+		if (!krlWriteProgram(partPath, krlCompileProgram(conv, settings)) || !ofFile::moveFromTo(partPath, outPath, false, true)) {
+			throw std::runtime_error("could not write " + outPath);
+		}
+
+		uint64_t ms = std::max<uint64_t>(1, ofGetElapsedTimeMillis() - startTime);
+
+		converted++;
+		log = "Watch service: " + fileName + " -> " + outPath + (hasSidecar ? " (sidecar)" : "") + ", " + ofToString(gCode.size()) + " lines, "
+			+ ofToString(conv.toolpathBuffer.size()) + " moves in " + ofToString(ms) + " ms (" + ofToString(gCode.size() / ms) + " klines/s)";
+
+	}
+	catch (std::exception& e) {
+
+		failed++;
+		log = "Watch service: error converting " + fileName + ": " + e.what();
+
+	}
+
+	queued--;
+
+	{
+		std::unique_lock<std::mutex> lock(pendingMutex);
+
+		if (pending[fileName] == pendingChanged) {
+			pending[fileName] = pendingQueued;
+			queued++;
+			queue.send(fileName);
+		}
+		else {
+			pending.erase(fileName);
+		}
+	}
+
+	//One write per file so lines of parallel workers don't interleave
+	std::cout << log + "\n" << std::flush;
+
+}
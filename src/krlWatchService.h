@@ -0,0 +1,71 @@
+#pragma once
+
+#include "ofMain.h"
+#include "krlConverter.h"
+
+class krlWatchService;
+
+//Pool thread, takes file names from the service queue until the queue is closed
+class krlWatchWorker : public ofThread {
+
+	public:
+		krlWatchWorker(krlWatchService& service);
+
+	protected:
+		void threadedFunction();
+
+	private:
+		krlWatchService& service;
+
+};
+
+//Converts every .gcode file that lands in inputDir to a .src in outputDir. This thread only watches the
+//directory (inotify on Linux, polling elsewhere), the conversions run on the worker pool.
+//Settings come from the defaults passed in, overridden per file by a <name>.xml sidecar next to the
+//gcode (same element names as settings.xml). Drop the sidecar before the gcode.
+class krlWatchService : public ofThread {
+
+	public:
+		krlWatchService(const std::string& inputDir, const std::string& outputDir, const krlSettings& defaults, unsigned int workerCount);
+		~krlWatchService();
+
+		void start();
+		void stop();
+
+		std::string getStatus();
+
+	protected:
+		void threadedFunction();
+
+	private:
+		friend class krlWatchWorker;
+
+		void enqueue(const std::string& fileName);
+		void enqueueExisting();
+		void convertFile(const std::string& fileName);
+
+		void openWatch();
+		void watchInotify();
+		void watchPolling();
+
+		std::string inputDir;
+		std::string outputDir;
+		krlSettings defaults;
+
+		ofThreadChannel<std::string> queue;
+		std::vector<std::unique_ptr<krlWatchWorker>> workers;
+
+		//Files queued or being converted. A file is in the queue at most once and converted by one worker
+		//at a time, a file that changes again while it is converted goes back in the queue afterwards.
+		enum pendingState { pendingQueued, pendingConverting, pendingChanged };
+		std::map<std::string, pendingState> pending;
+		std::mutex pendingMutex;
+
+		int watchFd;
+		std::atomic<unsigned int> partCounter;
+
+		std::atomic<unsigned int> queued;
+		std::atomic<unsigned int> converted;
+		std::atomic<unsigned int> failed;
+
+};
@@ -11,6 +11,9 @@ void ofApp::setup(){
 	mFileMan.add(mFileOpen.set("Open ArcWelded File", false));
 	mFileMan.add(mFileSave.set("Save ArcWelded KRL", false));
 	mFileMan.add(mFileProcess.set("Process current", false));
+	mFileMan.add(mFileUseCache.set("Use conversion cache", true));
+	mFileMan.add(mFileSaveTable.set("Save as point tables", false));
+	mFileMan.add(mFileTableChunk.set("Points per array", krlTableDefaultChunk, 100, 30000));
 	menu.add(mFileMan);
 	
 	//Gui for managing extrusion params
@@ -26,7 +29,50 @@ void ofApp::setup(){
 	mPrintPosition.add(mPrintOrigin.set("Print origin [mm]",ofVec2f(0,0),ofVec2f(0,0),ofVec2f(3000,3000)));
 	mPrintPosition.add(mPrintHeightOffset.set("Print Z offset [mm]",0,0,1000.0f));
 	mPrintPosition.add(mPrintSpeed.set("Print speed [m/s]", 0.0f, 0.0f, 0.2f));
+	mPrintPosition.add(mPrintRotation.set("Print rotation [deg]", 0.0f, -180.0f, 180.0f));
+	mPrintPosition.add(mPrintTilt.set("Tilt compensation", false));
+	for (int i = 0; i < 3; i++) {
+		mPrintPosition.add(mPrintProbe[i].set("Bed probe " + ofToString(i + 1) + " [mm]", ofVec3f(0, 0, 0), ofVec3f(0, 0, -500), ofVec3f(3000, 3000, 1000)));
+	}
 	menu.add(mPrintPosition);
+
+	//Gui for jumping to layers and restarting a print from one
+	mLayerMan.setName("Layer navigation");
+	mLayerMan.add(mLayerSelect.set("Layer", 0, 0, 0));
+	mLayerMan.add(mLayerApproachHeight.set("Restart approach height [mm]", 50.0f, 0.0f, 500.0f));
+	mLayerMan.add(mLayerSaveRestart.set("Save restart from layer", false));
+	menu.add(mLayerMan);
+
+	//Gui for the pre-flight check of the placed toolpath, limits in the robot base frame
+	mCheckMan.setName("Preflight check");
+	mCheckMan.add(mCheckRun.set("Run preflight check", false));
+	mCheckMan.add(mCheckOnProcess.set("Check after process", true));
+	mCheckMan.add(mCheckWorkspaceMin.set("Workspace min [mm]", ofVec3f(-3000, -3000, 0), ofVec3f(-5000, -5000, -1000), ofVec3f(5000, 5000, 5000)));
+	mCheckMan.add(mCheckWorkspaceMax.set("Workspace max [mm]", ofVec3f(3000, 3000, 2500), ofVec3f(-5000, -5000, -1000), ofVec3f(5000, 5000, 5000)));
+	mCheckMan.add(mCheckKeepOutFile.set("Keep out file", "keepout.xml"));
+	mCheckMan.add(mCheckMaxArcRadius.set("Max arc radius [mm]", 2000.0f, 1.0f, 10000.0f));
+	mCheckMan.add(mCheckMaxMidpointDeviation.set("Max midpoint deviation [mm]", 1.0f, 0.0f, 50.0f));
+	menu.add(mCheckMan);
+
+	//Gui for streaming the toolpath to the controller instead of saving a program
+	mStreamMan.setName("Streaming");
+	mStreamMan.add(mStreamRun.set("Stream to controller", false));
+	mStreamMan.add(mStreamOnProcess.set("Stream after process", false));
+	mStreamMan.add(mStreamSimulate.set("Local simulator", true));
+	mStreamMan.add(mStreamHost.set("Controller IP", "172.31.1.147"));
+	mStreamMan.add(mStreamPort.set("Port", 54600, 1024, 65535));
+	mStreamMan.add(mStreamWindow.set("Window [moves]", 256, 1, krlStreamBufferLimit - 1));
+	mStreamMan.add(mStreamBatch.set("Batch [moves]", 32, 1, 256));
+	mStreamMan.add(mStreamSaveInterpreter.set("Save stream interpreter", false));
+	menu.add(mStreamMan);
+
+	//Gui for the watch folder service, converts everything dropped in the input directory
+	mWatchMan.setName("Watch folder service");
+	mWatchMan.add(mWatchRun.set("Run watch service", false));
+	mWatchMan.add(mWatchInputDir.set("Input directory", "watch-in"));
+	mWatchMan.add(mWatchOutputDir.set("Output directory", "watch-out"));
+	mWatchMan.add(mWatchWorkers.set("Worker threads", 4, 1, 32));
+	menu.add(mWatchMan);
 	
 	//Load menu data before assigning callbacks!
 	menu.loadFromFile(ofxPanelDefaultFilename);
@@ -35,6 +81,13 @@ void ofApp::setup(){
 	mFileOpen.addListener(this, &ofApp::mFileOpenListener);
 	mFileSave.addListener(this, &ofApp::mFileSaveListener);
 	mFileProcess.addListener(this, &ofApp::mFileProcessListener);
+	mFileSaveTable.addListener(this, &ofApp::mFileSaveTableListener);
+	mWatchRun.addListener(this, &ofApp::mWatchRunListener);
+	mLayerSelect.addListener(this, &ofApp::mLayerSelectListener);
+	mLayerSaveRestart.addListener(this, &ofApp::mLayerSaveRestartListener);
+	mCheckRun.addListener(this, &ofApp::mCheckRunListener);
+	mStreamRun.addListener(this, &ofApp::mStreamRunListener);
+	mStreamSaveInterpreter.addListener(this, &ofApp::mStreamSaveInterpreterListener);
 
 	//Include speed in general extrusion params, KUKA assumes all rates at 100% travel speed!
 	mExtLayerHeight.addListener(this, &ofApp::mExtCalculateExtrusionData);
@@ -44,10 +97,17 @@ void ofApp::setup(){
 	mPrintSpeed.addListener(this, &ofApp::mExtCalculateExtrusionData);
 
 	guiCodeViewPosition = 0;
+	guiKrlViewPosition = 0;
+	guiPickedMove = -1;
+	gCodeHash = 0;
 
 	float emptyTrigger = 0.0f;
 	mExtCalculateExtrusionData(emptyTrigger);
 
+	//Service mode; settings.xml can have the watch service running straight from launch
+	bool watchTrigger = mWatchRun.get();
+	mWatchRunListener(watchTrigger);
+
 	softwareDescription = "This software is intended to convert .gcode (PrusaSlicer 2.7.1) files into .src (KRL 1.4) files. It accepts\n";
 	softwareDescription += "either pure G1/G0 files or files exported with G0/G1/G2/G3 from prusaSlicer. The intention is to reduce\n";
 	softwareDescription += "the file size, so G2 and G3 are recommended. In spiral vase mode prusaSlicer does not support G2/G3 arcs \n";
@@ -72,36 +132,8 @@ void ofApp::setup(){
 void ofApp::mExtCalculateExtrusionData(float& sender) {
 	std::cout << "Extrusion calculation callback" << std::endl;
 
-	float eHeight = mExtLayerHeight.get();
-	float eWidth = mExtLayerWidth.get();
-	float mSpeed = mPrintSpeed.get();
-
-	std::cout << "Inputs: " << eHeight << ", " << eWidth << ", " << mSpeed << std::endl;
-
-	//Calculate surface of extrusion over Z-X, which is a slot. Take rectangular volume, subtract the round corners
-	//by subtracting round layer height from square layer height. 
-	float eSurface = (eHeight * eWidth) - ((eHeight * eHeight) - (PI * ((eHeight / 2) * (eHeight / 2))));
-	
-	//Calculate distance traveled per minute
-	float dMinute = mPrintSpeed.get() * 60.0f;
-	std::cout << "Traveled distance per minute [m/min]: " << dMinute << std::endl;
-
-	//Multiply the distance traveled at max speed by theoretical extruded cross section
-	float eVolumeMinute = (dMinute * 1000.0f) * eSurface;
-	std::cout << "Extrusion volume at max speed [mm3/min]: " << eVolumeMinute << std::endl;
-	
-	//Put previous calculated volume in its final perspective for volume; convert from mm3 to cm3
-	eVolumeMinute = eVolumeMinute / 1000.0f;
-	std::cout << "Extrusion volume at max speed [cm3/min]: " << eVolumeMinute << std::endl;
-
-	//Devide the requested volume per minute by the volume provided per rotation resulting in RPM
-	float calculatedFeed = eVolumeMinute / mExtVolumeRev.get();
-	std::cout << "Calculated feed [RPM] : " << calculatedFeed << std::endl;
-	
-	//Set this value; min 0, max 150 rpm, this will be reference on final export.
-	mExtCalculatedFC.set(ofMap(calculatedFeed, 0, 150, 0, 1, true) / mPrintSpeed.get());
-
-	
+	//Set this value, this will be reference on final export.
+	mExtCalculatedFC.set(krlCalculateFlowCorrection(mExtLayerHeight.get(), mExtLayerWidth.get(), mExtVolumeRev.get(), mPrintSpeed.get(), true));
 
 }
 
@@ -119,35 +151,20 @@ void ofApp::mFileOpenListener(bool& sender) {
 
 
 			gCodeBuffer.clear();
-			gCodeFilteredBuffer.clear();
-			krlCodeBuffer.clear();
-			guiPoly.clear();
-			midPointCollection.clear();
+			conversion.clear();
+			pickIndex.clear();
+			violations.clear();
+			checkStatus.clear();
+			guiPickedMove = -1;
+			guiLayerPoly.clear();
 
 			std::cout << "Correct, gcode extension" << std::endl;
 			ofBuffer cBuf = ofBufferFromFile(res.filePath);
 
-			unsigned int lNum = 0;
-			for (auto line : cBuf.getLines()) {
-				
-				if (!line.empty()) {
-					
-					if (line.at(0) == 'G' || line.at(0) == 'M') {
+			//Content hash, used as cache key on process
+			gCodeHash = krlHashBytes(cBuf.getData(), cBuf.size());
 
-						gCodeBuffer.push_back(line);
-
-					}
-					else {
-
-						std::cout << "Discarded line " << lNum << ": " << line << std::endl;
-
-					}
-
-				}
-
-				lNum++;
-			
-			}
+			gCodeBuffer = krlFilterGCode(cBuf, true);
 
 			std::cout << "Actual movement lines: " << gCodeBuffer.size();
 
@@ -168,40 +185,49 @@ void ofApp::mFileOpenListener(bool& sender) {
 	mFileOpen.set(false);
 
 }
-void ofApp::mFileSaveListener(bool& sender) {
-	std::cout << "Save callback!" << std::endl;
+std::string ofApp::mAskSrcSavePath() {
 
 	ofFileDialogResult fRes = ofSystemSaveDialog("File destination", "src only");
 
-	if (fRes.bSuccess && !fRes.filePath.empty()) {
+	if (!fRes.bSuccess || fRes.filePath.empty()) {
+		return "";
+	}
 
-		std::string fullSavePath = "";
+	std::string fullSavePath = "";
+	
+	//Check for entered extension, if none existing or different change the file extension
+	if(fRes.filePath.find('.') != std::string::npos){
 		
-		//Check for entered extension, if none existing or different change the file extension
-		if(fRes.filePath.find('.') != std::string::npos){
-			
-			size_t extPos = fRes.filePath.find('.');
-			std::string extType = fRes.filePath.substr(extPos);
-
-			if (extType == ".src") {
-				fullSavePath = fRes.filePath;
-			}
-			else {
-				fullSavePath = fRes.filePath.substr(0, extPos) + ".src";
-
-			}
+		size_t extPos = fRes.filePath.find('.');
+		std::string extType = fRes.filePath.substr(extPos);
 
+		if (extType == ".src") {
+			fullSavePath = fRes.filePath;
 		}
 		else {
-			fullSavePath = fRes.filePath + ".src";
+			fullSavePath = fRes.filePath.substr(0, extPos) + ".src";
+
 		}
 
-		//Check for illegal characters in the filename and change or remove them!
-		//Apart from normal filename illegalness (!,/,\) Kuka doesnt like hyphens!
-		size_t changeFrom = fullSavePath.find_last_of('\\');
-		std::replace(fullSavePath.begin()+changeFrom, fullSavePath.end(), '-', '_');
-		
-		std::cout << "Save path / file: " << fullSavePath << std::endl;
+	}
+	else {
+		fullSavePath = fRes.filePath + ".src";
+	}
+
+	//Check for illegal characters in the filename and change or remove them!
+	fullSavePath = krlSanitizeSavePath(fullSavePath);
+	
+	std::cout << "Save path / file: " << fullSavePath << std::endl;
+
+	return fullSavePath;
+}
+
+void ofApp::mFileSaveListener(bool& sender) {
+	std::cout << "Save callback!" << std::endl;
+
+	std::string fullSavePath = mAskSrcSavePath();
+
+	if (!fullSavePath.empty()) {
 
 		//Warn users for the possible dangers of this software!
 		std::string warnText =	"WARNING! \n";
@@ -214,431 +240,388 @@ void ofApp::mFileSaveListener(bool& sender) {
 		warnText +=				" - Double check the code in preview, product of this program is your liability :')\n\n";
 		warnText +=				"HAVE A NICE PRINT";
 
+		if (!violations.empty()) {
+			warnText += "\n\nPRE-FLIGHT CHECK: " + ofToString(violations.size()) + " violations, first at KRL line "
+				+ ofToString(conversion.toolpathBuffer.at(violations.front().move).krlLine) + ": " + violations.front().reason;
+		}
+
 		guiToggleCodeView = true;
 
 		ofSystemAlertDialog(warnText);
 
-		//Compile KRL file!
-		std::vector<std::string> krlOutput;
+		//Compile and write KRL file!
+		std::vector<std::string> krlOutput = krlCompileProgram(conversion, mGetKrlSettings());
+
+		if (!krlWriteProgram(fullSavePath, krlOutput)) {
+			std::cout << "Could not write " << fullSavePath << std::endl;
+		}
+
+	}
 
-		krlOutput.push_back("DEF ofgen()");
 
-		krlOutput.push_back("GLOBAL INTERRUPT DECL 3 WHEN $STOPMESS==TRUE DO IR_STOPM ( )");
-		krlOutput.push_back("INTERRUPT ON 3");
-		krlOutput.push_back("BAS (#INITMOV,0 )");
 
-		krlOutput.push_back("ANOUT ON AO_EXTRUDER_RPM = FLOW_CORRECTION * $VEL_ACT +0.0 DELAY=-0.2");
-		krlOutput.push_back("FLOW_CORRECTION = " + ofToString(mExtCalculatedFC.get(),3));
+	mFileSave.set(false);
+}
+void ofApp::mFileSaveTableListener(bool& sender) {
+	std::cout << "Save tables callback!" << std::endl;
 
-		krlOutput.push_back("$BWDSTART = FALSE");
-		krlOutput.push_back("PDAT_ACT = {VEL 15,ACC 100,APO_DIST 50}");
-		krlOutput.push_back("BAS(#PTP_DAT)");
-		krlOutput.push_back("FDAT_ACT = {TOOL_NO 6,BASE_NO 0,IPO_FRAME #BASE}");
-		krlOutput.push_back("BAS(#FRAMES)");
+	if (conversion.toolpathBuffer.empty()) {
 
-		krlOutput.push_back("BAS (#VEL_PTP,15)");
-		krlOutput.push_back("PTP  {A1 5,A2 -90,A3 100,A4 5,A5 -10,A6 -5,E1 0,E2 0,E3 0,E4 0}");
+		std::cout << "Nothing to save, process a file first." << std::endl;
 
-		krlOutput.push_back("$VEL.CP=" + ofToString(mPrintSpeed.get(), 2));
-		krlOutput.push_back("$ADVANCE=3");
+	}
+	else {
 
-		for (auto i : krlCodeBuffer) {
+		std::string fullSavePath = mAskSrcSavePath();
 
-			krlOutput.push_back(i);
+		if (!fullSavePath.empty()) {
 
-		}
+			std::string warnText =	"WARNING! \n";
+			warnText +=				"The toolpath will be saved as point tables (.dat) with a looping .src, keep both files together on the KUKA.\n";
+			warnText +=				"Same checks as a normal save: origin, midpoints, Z-height and a first dry run at low speed!";
 
-		krlOutput.push_back("END");
+			guiToggleCodeView = true;
 
-		//Write file
-		ofFile nFile = ofFile(fullSavePath, ofFile::Mode::Append, false);
-		
-		if (nFile.exists()) {
-			nFile.remove();
-		}
-		
-		if (nFile.create()) {
-			if (nFile.open(fullSavePath, ofFile::Mode::Append, false)) {
+			ofSystemAlertDialog(warnText);
 
-				for (auto i : krlOutput) {
-					nFile << i << std::endl;
-				}
+			//The .dat has to carry the same name as the .src it belongs to
+			std::string programName = ofFilePath::getBaseName(fullSavePath);
+			std::string datPath = ofFilePath::join(ofFilePath::getEnclosingDirectory(fullSavePath, false), programName + ".dat");
 
-				nFile.close();
+			std::vector<std::string> srcOutput;
+			std::vector<std::string> datOutput;
+			krlCompileTableProgram(conversion, mGetKrlSettings(), programName, mFileTableChunk.get(), srcOutput, datOutput);
 
+			if (!krlWriteProgram(fullSavePath, srcOutput) || !krlWriteProgram(datPath, datOutput)) {
+				std::cout << "Could not write " << fullSavePath << " / " << datPath << std::endl;
+			}
+			else {
+				std::cout << "Saved " << conversion.toolpathBuffer.size() << " moves in " << srcOutput.size() << " program lines and "
+					<< datOutput.size() << " data lines (" << ofFile(fullSavePath).getSize() + ofFile(datPath).getSize() << " bytes)" << std::endl;
 			}
 
 		}
 
 	}
 
-
-
-	mFileSave.set(false);
+	mFileSaveTable.set(false);
 }
 void ofApp::mFileProcessListener(bool& sender) {
 	std::cout << "Process callback!" << std::endl;
 
-	std::string popupMsgString;
-	popupMsgString = "Please understand this is a blocking function\n";
-	popupMsgString += "Complex G1/G0 scripts take way longer, check\n";
-	popupMsgString += "the console for actual action ;)";
+	if (!gCodeBuffer.empty()) {
 
-	ofSystemAlertDialog(popupMsgString);
+		krlSettings settings = mGetKrlSettings();
+		std::string cachePath = krlCachePath(gCodeHash, settings);
 
-	if (!gCodeBuffer.empty()) {
+		uint64_t startTime = ofGetElapsedTimeMillis();
 
-		gCodeFilteredBuffer.clear();
-		krlCodeBuffer.clear();
-		guiPoly.clear();
-		midPointCollection.clear();
+		if (mFileUseCache.get() && krlCacheLoad(cachePath, gCodeHash, settings, conversion)) {
 
-		std::cout << "Start gCode to polyline conversion!" << std::endl;
+			std::cout << "Loaded conversion from cache (" << cachePath << ") in " << ofGetElapsedTimeMillis() - startTime << " ms" << std::endl;
 
-		unsigned int lineNumber = 1;
-		bool firstLinear = false;
-		bool isExtruding = false;
-		ofVec3f lastPosition = ofVec3f(0, 0, 0);
-		ofVec3f currentPosition = ofVec3f(0, 0, 0);
+		}
+		else {
 
-		ofPolyline cPoly;
+			std::string popupMsgString;
+			popupMsgString = "Please understand this is a blocking function\n";
+			popupMsgString += "Complex G1/G0 scripts take way longer, check\n";
+			popupMsgString += "the console for actual action ;)";
 
-		for (auto line : gCodeBuffer) {
+			ofSystemAlertDialog(popupMsgString);
 
+			startTime = ofGetElapsedTimeMillis();
 
-			bool processFlag = false;
-			ofVec2f currentArcOffset = ofVec2f(0, 0);
-			bool hasE = line.find('E') != std::string::npos;
-			
-			bool hasX = line.find('X') != std::string::npos;
-			bool hasY = line.find('Y') != std::string::npos;
-			bool hasZ = line.find('Z') != std::string::npos;
-			
-			bool hasI = line.find('I') != std::string::npos;
-			bool hasJ = line.find('J') != std::string::npos;
+			std::cout << "Start gCode to polyline conversion!" << std::endl;
 
-			if (hasX) {
-				currentPosition.x = std::stof(line.substr(line.find('X') + 1, (line.find(' ', line.find('X')) - (line.find('X') + 1))));
-			}
-			if (hasY) {
-				currentPosition.y = std::stof(line.substr(line.find('Y') + 1, (line.find(' ', line.find('Y')) - (line.find('Y') + 1))));
-			}
-			if (hasZ) {
-				currentPosition.z = std::stof(line.substr(line.find('Z') + 1, (line.find(' ', line.find('Z')) - (line.find('Z') + 1))));
-			}
+			krlParseGCode(gCodeBuffer, conversion, true);
+			krlEmitCode(conversion, settings);
 
-			if (hasI) {
-				currentArcOffset.x = std::stof(line.substr(line.find('I') + 1, (line.find(' ', line.find('I')) - (line.find('I') + 1))));
-			}
-			if (hasJ) {
-				currentArcOffset.y = std::stof(line.substr(line.find('J') + 1, (line.find(' ', line.find('J')) - (line.find('J') + 1))));
+			std::cout << "Conversion took " << ofGetElapsedTimeMillis() - startTime << " ms" << std::endl;
+
+			if (mFileUseCache.get() && !krlCacheStore(cachePath, gCodeHash, settings, conversion)) {
+				std::cout << "Could not write cache entry " << cachePath << std::endl;
 			}
 
-			
+		}
 
-			if (line.find("G0") != std::string::npos) {
+		//Spatial index for clicking moves in the preview
+		startTime = ofGetElapsedTimeMillis();
+		pickIndex.build(conversion.toolpathBuffer);
+		guiPickedMove = -1;
 
-				if (hasZ && !hasX && !hasY) {
-					//Do nothing, just a position change if coordinate is new
-					if (lastPosition.z != currentPosition.z) {
-						
-						std::cout << "Make new point, old z: " << lastPosition.z << ",new z: " << currentPosition.z << std::endl;
-						cPoly.addVertex(currentPosition);
+		std::cout << "Pick index built in " << ofGetElapsedTimeMillis() - startTime << " ms" << std::endl;
 
-						//Switch extrusion on and off
-						if (hasE && !isExtruding) {
+		std::cout << "Layers: " << conversion.layerIndex.size() << std::endl;
+		mLayerSelect.setMax(std::max<int>(0, conversion.layerIndex.size() - 1));
+		mLayerSelect.setWithoutEventNotifications(0);
+		guiLayerPoly.clear();
 
-							krlCodeBuffer.push_back("TRIGGER WHEN DISTANCE = 0 DELAY = 0 DO O_EXTRUDER_START = TRUE");
-							isExtruding = true;
+		violations.clear();
+		checkStatus.clear();
 
-						}
+		if (mCheckOnProcess.get()) {
+			mCheckRun.set(true);
+		}
 
-						if (!hasE && isExtruding) {
+		//Straight to the controller, no save and transfer of the program
+		if (mStreamOnProcess.get()) {
+			mStreamRun.set(true);
+		}
 
-							krlCodeBuffer.push_back("TRIGGER WHEN DISTANCE = 0 DELAY = 0 DO O_EXTRUDER_START = FALSE");
-							isExtruding = false;
-						}
-						
-						//Check if this is the first line, if so use PTP
-						if (!firstLinear) {
-							krlCodeBuffer.push_back("PTP {X " + ofToString(currentPosition.x + mPrintOrigin.get().x,1) + ", Y " + ofToString(currentPosition.y + mPrintOrigin.get().y,1) + ", Z " + ofToString(currentPosition.z + mPrintHeightOffset.get(),1) + ", A 0, B 90, C 0, E1 0, E2 0, E3 0, E4 0, S 'B 110'} C_PTP");
-							firstLinear = true;
-						}
-						else {
+	}
+	else {
 
-							krlCodeBuffer.push_back("LIN{ X " + ofToString(currentPosition.x + mPrintOrigin.get().x,1) + ", Y " + ofToString(currentPosition.y + mPrintOrigin.get().y,1) + ", Z " + ofToString(currentPosition.z + mPrintHeightOffset.get(),1) + ", A 0, B 90, C 0 } C_DIS");
+		std::cout << "gCode buffer is empty, stop." << std::endl;
 
-						}
+	}
 
-						processFlag = true;
+	mFileProcess.set(false);
 
-					}
-					
-				}
-				if (hasX && hasY) {
-					cPoly.addVertex(currentPosition);
+}
 
-					//Switch extrusion on and off
-					if (hasE && !isExtruding) {
+krlSettings ofApp::mGetKrlSettings() {
+
+	krlSettings settings;
+	settings.origin = mPrintOrigin.get();
+	settings.heightOffset = mPrintHeightOffset.get();
+	settings.speed = mPrintSpeed.get();
+	settings.flowCorrection = mExtCalculatedFC.get();
+	settings.layerHeight = mExtLayerHeight.get();
+	settings.layerWidth = mExtLayerWidth.get();
+	settings.volumePerRev = mExtVolumeRev.get();
+	settings.rotation = mPrintRotation.get();
+	settings.tiltCompensation = mPrintTilt.get();
+
+	for (int i = 0; i < 3; i++) {
+		settings.probe[i] = mPrintProbe[i].get();
+	}
 
-						krlCodeBuffer.push_back("TRIGGER WHEN DISTANCE = 0 DELAY = 0 DO O_EXTRUDER_START = TRUE");
-						isExtruding = true;
+	return settings;
+}
 
-					}
+void ofApp::mLayerSelectListener(int& sender) {
 
-					if (!hasE && isExtruding) {
+	if (sender < 0 || (size_t)sender >= conversion.layerIndex.size()) {
+		return;
+	}
 
-						krlCodeBuffer.push_back("TRIGGER WHEN DISTANCE = 0 DELAY = 0 DO O_EXTRUDER_START = FALSE");
-						isExtruding = false;
-					}
+	const krlLayer& layer = conversion.layerIndex.at(sender);
 
-					//Check if this is the first line, if so use PTP
-					if (!firstLinear) {
-						krlCodeBuffer.push_back("PTP {X " + ofToString(currentPosition.x + mPrintOrigin.get().x,1) + ", Y " + ofToString(currentPosition.y + mPrintOrigin.get().y,1) + ", Z " + ofToString(currentPosition.z + mPrintHeightOffset.get(),1) + ", A 0, B 90, C 0, E1 0, E2 0, E3 0, E4 0, S 'B 110'} C_PTP");
-						firstLinear = true;
-					}
-					else {
+	//Outline of the layer for the preview, arcs as chords through their midpoint
+	guiLayerPoly.clear();
+	ofVec3f layerMin = conversion.toolpathBuffer.at(layer.firstMove).target;
+	ofVec3f layerMax = layerMin;
 
-						krlCodeBuffer.push_back("LIN{ X " + ofToString(currentPosition.x + mPrintOrigin.get().x,1) + ", Y " + ofToString(currentPosition.y + mPrintOrigin.get().y,1) + ", Z " + ofToString(currentPosition.z + mPrintHeightOffset.get(),1) + ", A 0, B 90, C 0 } C_DIS");
+	for (uint32_t i = layer.firstMove; i <= layer.lastMove; i++) {
 
-					}
+		const krlMove& move = conversion.toolpathBuffer.at(i);
 
-					processFlag = true;
-				}
+		if (move.type == krlMove::CIRC) {
+			guiLayerPoly.addVertex(move.aux);
+		}
+		guiLayerPoly.addVertex(move.target);
 
-				
-				
-			}
-			else if (line.find("G1") != std::string::npos) {
+		layerMin = ofVec3f(std::min(layerMin.x, move.target.x), std::min(layerMin.y, move.target.y), std::min(layerMin.z, move.target.z));
+		layerMax = ofVec3f(std::max(layerMax.x, move.target.x), std::max(layerMax.y, move.target.y), std::max(layerMax.z, move.target.z));
+	}
 
-				if (hasZ && !hasX && !hasY) {
-					//Do nothing, just a position change if coordinate is new
-					if (lastPosition.z != currentPosition.z) {
-						std::cout << "Make new point, old z: " << lastPosition.z << ",new z: " << currentPosition.z << std::endl;
-						cPoly.addVertex(currentPosition);
+	//The preview is drawn rotated, so is the center of the layer
+	krlPlacement placement = krlMakePlacement(mGetKrlSettings());
+	ofVec3f layerCenter = (layerMin + layerMax) / 2;
+	guiCam.setTarget(placement.xAxis * layerCenter.x + placement.yAxis * layerCenter.y + placement.zAxis * layerCenter.z);
 
-						//Switch extrusion on and off
-						if (hasE && !isExtruding) {
+	guiCodeViewPosition = conversion.toolpathBuffer.at(layer.firstMove).gCodeLine;
+	guiKrlViewPosition = layer.firstKrlLine;
+	guiToggleCodeView = true;
 
-							krlCodeBuffer.push_back("TRIGGER WHEN DISTANCE = 0 DELAY = 0 DO O_EXTRUDER_START = TRUE");
-							isExtruding = true;
+	std::cout << "Layer " << sender << ": Z " << layer.z << ", moves " << layer.firstMove << "-" << layer.lastMove << ", KRL lines " << layer.firstKrlLine << "-" << layer.lastKrlLine << ", extruding at entry " << int(layer.extruding) << std::endl;
 
-						}
+}
 
-						if (!hasE && isExtruding) {
+void ofApp::mLayerSaveRestartListener(bool& sender) {
 
-							krlCodeBuffer.push_back("TRIGGER WHEN DISTANCE = 0 DELAY = 0 DO O_EXTRUDER_START = FALSE");
-							isExtruding = false;
-						}
+	std::cout << "Save restart callback!" << std::endl;
 
-						//Check if this is the first line, if so use PTP
-						if (!firstLinear) {
-							krlCodeBuffer.push_back("PTP {X " + ofToString(currentPosition.x + mPrintOrigin.get().x,1) + ", Y " + ofToString(currentPosition.y + mPrintOrigin.get().y,1) + ", Z " + ofToString(currentPosition.z + mPrintHeightOffset.get(),1) + ", A 0, B 90, C 0, E1 0, E2 0, E3 0, E4 0, S 'B 110'} C_PTP");
-							firstLinear = true;
-						}
-						else {
+	if (conversion.layerIndex.empty()) {
 
-							krlCodeBuffer.push_back("LIN{ X " + ofToString(currentPosition.x + mPrintOrigin.get().x,1) + ", Y " + ofToString(currentPosition.y + mPrintOrigin.get().y,1) + ", Z " + ofToString(currentPosition.z + mPrintHeightOffset.get(),1) + ", A 0, B 90, C 0 } C_DIS");
+		std::cout << "No layers, process a file first." << std::endl;
 
-						}
-						
-						processFlag = true;
-					}
-					
-				}
-				if (hasX && hasY) {
-					cPoly.addVertex(currentPosition);
+	}
+	else {
 
-					//Switch extrusion on and off
-					if (hasE && !isExtruding) {
+		std::string fullSavePath = mAskSrcSavePath();
 
-						krlCodeBuffer.push_back("TRIGGER WHEN DISTANCE = 0 DELAY = 0 DO O_EXTRUDER_START = TRUE");
-						isExtruding = true;
+		if (!fullSavePath.empty()) {
 
-					}
+			std::string warnText =	"WARNING! \n";
+			warnText +=				"Restart program from layer " + ofToString(mLayerSelect.get()) + " (Z " + ofToString(conversion.layerIndex.at(mLayerSelect.get()).z, 2) + ").\n";
+			warnText +=				"The robot goes home, then PTP to " + ofToString(mLayerApproachHeight.get(), 0) + " mm above the start of the layer and LIN down.\n";
+			warnText +=				"Make sure the part has room for that approach and the previous layer is really finished!";
 
-					if (!hasE && isExtruding) {
+			//The rest of the program is the code of the last process, the approach has to match it
+			if (!krlSamePlacement(mGetKrlSettings(), conversion.settings)) {
+				warnText +=			"\n\nThe print position changed since the last process. The restart uses the processed position,\n";
+				warnText +=			"origin " + ofToString(conversion.settings.origin.x, 1) + ", " + ofToString(conversion.settings.origin.y, 1) + " and Z offset " + ofToString(conversion.settings.heightOffset, 1) + ". Process again to use the new one.";
+			}
 
-						krlCodeBuffer.push_back("TRIGGER WHEN DISTANCE = 0 DELAY = 0 DO O_EXTRUDER_START = FALSE");
-						isExtruding = false;
-					}
+			ofSystemAlertDialog(warnText);
 
-					//Check if this is the first line, if so use PTP
-					if (!firstLinear) {
-						krlCodeBuffer.push_back("PTP {X " + ofToString(currentPosition.x + mPrintOrigin.get().x,1) + ", Y " + ofToString(currentPosition.y + mPrintOrigin.get().y,1) + ", Z " + ofToString(currentPosition.z + mPrintHeightOffset.get(),1) + ", A 0, B 90, C 0, E1 0, E2 0, E3 0, E4 0, S 'B 110'} C_PTP");
-						firstLinear = true;
-					}
-					else {
+			std::vector<std::string> krlOutput = krlCompileRestartProgram(conversion, mGetKrlSettings(), mLayerSelect.get(), mLayerApproachHeight.get());
 
-						krlCodeBuffer.push_back("LIN{ X " + ofToString(currentPosition.x + mPrintOrigin.get().x,1) + ", Y " + ofToString(currentPosition.y + mPrintOrigin.get().y,1) + ", Z " + ofToString(currentPosition.z + mPrintHeightOffset.get(),1) + ", A 0, B 90, C 0 } C_DIS");
+			if (!krlWriteProgram(fullSavePath, krlOutput)) {
+				std::cout << "Could not write " << fullSavePath << std::endl;
+			}
 
-					}
+		}
 
-					processFlag = true;
-				}
+	}
 
-				
+	mLayerSaveRestart.set(false);
 
-			}
-			else if (line.find("G21") != std::string::npos) {
-				//Catch this exception, do nothing!
-				std::cout << "G21 found at " << lineNumber << std::endl;
-			}
-			else if (line.find("G2") != std::string::npos) {
-				
-				//Arc clockwise
-				if (hasI && hasJ && hasX && hasY) {
+}
 
+void ofApp::mCheckRunListener(bool& sender) {
 
-					
-					//Gui calculations
-					ofVec2f arcCent = ofVec2f(lastPosition.x + currentArcOffset.x, lastPosition.y + currentArcOffset.y);
-					float arcRad = sqrt(pow(abs(currentArcOffset.x), 2) + pow(abs(currentArcOffset.y), 2));
-					float startAngle = atan2(lastPosition.y - arcCent.y, lastPosition.x - arcCent.x) * (180 / PI);
-					float endAngle = atan2(currentPosition.y - arcCent.y, currentPosition.x - arcCent.x) * (180 / PI);
+	std::cout << "Pre-flight check callback!" << std::endl;
 
-					cPoly.arcNegative(arcCent.x, arcCent.y, currentPosition.z, arcRad, arcRad, startAngle, endAngle);
-					
+	if (conversion.toolpathBuffer.empty()) {
 
-					//Switch extrusion on and off
-					if (hasE && !isExtruding) {
+		std::cout << "Nothing to check, process a file first." << std::endl;
 
-						krlCodeBuffer.push_back("TRIGGER WHEN DISTANCE = 0 DELAY = 0 DO O_EXTRUDER_START = TRUE");
-						isExtruding = true;
+	}
+	else {
 
-					}
+		uint64_t startTime = ofGetElapsedTimeMillis();
 
-					if (!hasE && isExtruding) {
+		krlLimits limits;
+		limits.workspace.min = mCheckWorkspaceMin.get();
+		limits.workspace.max = mCheckWorkspaceMax.get();
+		limits.maxArcRadius = mCheckMaxArcRadius.get();
+		limits.maxMidpointDeviation = mCheckMaxMidpointDeviation.get();
 
-						krlCodeBuffer.push_back("TRIGGER WHEN DISTANCE = 0 DELAY = 0 DO O_EXTRUDER_START = FALSE");
-						isExtruding = false;
-					}
-					
-					//Auxilary point calculations for KRL (midpoint)
-					float startAngleRad = atan2(lastPosition.y - arcCent.y, lastPosition.x - arcCent.x);
-					float endAngleRad = atan2(currentPosition.y - arcCent.y, currentPosition.x - arcCent.x);
+		//A missing file is no keep-out zones, a broken one is worth mentioning
+		std::string keepOutPath = ofToDataPath(mCheckKeepOutFile.get());
+		if (ofFile::doesFileExist(keepOutPath, false) && !krlLoadKeepOut(keepOutPath, limits.keepOut)) {
+			std::cout << "Could not read keep-out boxes from " << keepOutPath << std::endl;
+		}
 
+		violations = krlValidateToolpath(conversion, limits, std::thread::hardware_concurrency());
 
-					float a = startAngleRad - endAngleRad;
-					float aDelta = atan2(sin(a), cos(a));
+		uint64_t ms = ofGetElapsedTimeMillis() - startTime;
 
-					
-					if (aDelta < 0) {
-						aDelta += 2 * PI;
-					}
+		if (violations.empty()) {
+			checkStatus = "Pre-flight: " + ofToString(conversion.toolpathBuffer.size()) + " moves OK in " + ofToString(ms) + " ms";
+		}
+		else {
+			checkStatus = "Pre-flight: " + ofToString(violations.size()) + " violations in " + ofToString(ms) + " ms, (n) next violation";
 
-					float midAngleRad = startAngleRad - (aDelta / 2);
-					float midPx = (cos(midAngleRad) * arcRad) + arcCent.x;
-					float midPy = (sin(midAngleRad) * arcRad) + arcCent.y;
-					float midPz = currentPosition.z - ((currentPosition.z - lastPosition.z) / 2);
+			//Show the first one straight away
+			guiKrlViewPosition = conversion.toolpathBuffer.at(violations.front().move).krlLine;
+			guiCodeViewPosition = conversion.toolpathBuffer.at(violations.front().move).gCodeLine;
+			guiToggleCodeView = true;
+		}
 
-					ofVec3f midPointCoord = ofVec3f(midPx, midPy, midPz);
+		std::cout << checkStatus << ", " << limits.keepOut.size() << " keep-out boxes" << std::endl;
 
-					midPointCollection.push_back(midPointCoord);
-					krlCodeBuffer.push_back("CIRC { X " + ofToString(midPointCoord.x + mPrintOrigin.get().x,1) + ", Y " + ofToString(midPointCoord.y + mPrintOrigin.get().y,1) + ", Z " + ofToString(midPointCoord.z + mPrintHeightOffset.get(),1) + "},{ X " + ofToString(currentPosition.x + mPrintOrigin.get().x,1) + ", Y " + ofToString(currentPosition.y + mPrintOrigin.get().y,1) + ", Z " + ofToString(currentPosition.z + mPrintHeightOffset.get(),1) + ", A 0, B 90, C 0} C_DIS");
+	}
 
-				}
-				else {
+	mCheckRun.set(false);
 
-					std::cout << "Error; parameters for arc not found, ln: " << lineNumber << std::endl;
-				}
+}
 
-				processFlag = true;
+void ofApp::mStreamRunListener(bool& sender) {
 
-			}
-			else if (line.find("G3") != std::string::npos) {
+	//A running stream is always stopped, on a real robot that ends the print
+	streamer.reset();
+	streamSimulator.reset();
 
-				//Arc counterclockwise
-				if (hasI && hasJ && hasX && hasY) {
+	if (sender) {
 
-					//Gui calculations
-					ofVec2f arcCent		= ofVec2f(lastPosition.x + currentArcOffset.x, lastPosition.y + currentArcOffset.y);
-					float arcRad		= sqrt(pow(abs(currentArcOffset.x),2) + pow(abs(currentArcOffset.y),2));
-					float startAngle	= atan2(lastPosition.y-arcCent.y,lastPosition.x-arcCent.x)*(180/PI);
-					float endAngle		= atan2(currentPosition.y-arcCent.y, currentPosition.x-arcCent.x)*(180/PI);
+		//Streaming has no save dialog, violations of the preflight check are confirmed here. Also the path
+		//taken by "Stream after process".
+		std::string confirmation = "yes";
+		if (!violations.empty()) {
+			confirmation = ofSystemTextBoxDialog("PRE-FLIGHT CHECK: " + ofToString(violations.size()) + " violations, first: " + violations.front().reason
+				+ ".\nType yes to stream anyway", "");
+		}
 
-					cPoly.arc(arcCent.x,arcCent.y,currentPosition.z,arcRad,arcRad,startAngle,endAngle);
+		if (conversion.toolpathBuffer.empty()) {
 
-					//Switch extrusion on and off
-					if (hasE && !isExtruding) {
+			std::cout << "Nothing to stream, process a file first." << std::endl;
+			mStreamRun.set(false);
 
-						krlCodeBuffer.push_back("TRIGGER WHEN DISTANCE = 0 DELAY = 0 DO O_EXTRUDER_START = TRUE");
-						isExtruding = true;
+		}
+		else if (ofToLower(ofTrim(confirmation)) != "yes") {
 
-					}
+			std::cout << "Stream not started, " << violations.size() << " preflight violations" << std::endl;
+			mStreamRun.set(false);
 
-					if (!hasE && isExtruding) {
+		}
+		else {
 
-						krlCodeBuffer.push_back("TRIGGER WHEN DISTANCE = 0 DELAY = 0 DO O_EXTRUDER_START = FALSE");
-						isExtruding = false;
-					}
+			krlSettings settings = mGetKrlSettings();
+			std::string host = mStreamHost.get();
 
-					//Auxilary point calculations for KRL (midpoint)
-					float startAngleRad = atan2(lastPosition.y - arcCent.y, lastPosition.x - arcCent.x);
-					float endAngleRad = atan2(currentPosition.y - arcCent.y, currentPosition.x - arcCent.x);
-					
-					
-					float a = endAngleRad - startAngleRad;
-					float aDelta = atan2(sin(a), cos(a));
+			if (mStreamSimulate.get()) {
+				//12 ms is the interpolation cycle, the controller never plans moves faster than that. The advance
+				//matches $ADVANCE in the program header.
+				streamSimulator = std::make_unique<krlStreamSimulator>(mStreamPort.get(), krlStreamBufferLimit, 3, settings.speed, 12.0f);
+				streamSimulator->start();
+				host = "127.0.0.1";
+			}
 
-					
-					if (aDelta < 0) {
-						aDelta += 2*PI;
-					}
+			streamer = std::make_unique<krlStreamer>(conversion, host, mStreamPort.get(), mStreamWindow.get(), mStreamBatch.get());
+			streamer->start();
 
-					float midAngleRad = startAngleRad + (aDelta / 2);
-					float midPx = (cos(midAngleRad) * arcRad) + arcCent.x;
-					float midPy = (sin(midAngleRad) * arcRad) + arcCent.y;
-					float midPz = currentPosition.z - ((currentPosition.z - lastPosition.z) / 2);
-					
-					ofVec3f midPointCoord = ofVec3f(midPx,midPy,midPz);
+		}
 
-					midPointCollection.push_back(midPointCoord);
-					krlCodeBuffer.push_back("CIRC { X "+ofToString(midPointCoord.x + mPrintOrigin.get().x,1) + ", Y "+ofToString(midPointCoord.y + mPrintOrigin.get().y,1)+", Z "+ofToString(midPointCoord.z + mPrintHeightOffset.get(),1) + "},{ X "+ofToString(currentPosition.x + mPrintOrigin.get().x,1) + ", Y " + ofToString(currentPosition.y + mPrintOrigin.get().y,1) + ", Z " + ofToString(currentPosition.z + mPrintHeightOffset.get(),1) + ", A 0, B 90, C 0} C_DIS");
+	}
 
-					
+}
 
-				}
-				else {
+void ofApp::mStreamSaveInterpreterListener(bool& sender) {
 
-					std::cout << "Error; parameters for arc not found, ln: " << lineNumber << std::endl;
-				}
+	std::cout << "Save stream interpreter callback!" << std::endl;
 
-				processFlag = true;
+	std::string fullSavePath = mAskSrcSavePath();
 
-			}
-			else {
+	if (!fullSavePath.empty()) {
 
-				//Do nothing for now
+		//KRL wants the DEF name to match the file, the EKI channel config goes next to it
+		std::string programName = ofFilePath::getBaseName(fullSavePath);
+		std::string configPath = ofFilePath::join(ofFilePath::getEnclosingDirectory(fullSavePath, false), "OfStream.xml");
 
-			}
-			std::cout  << lineNumber << " ("<< processFlag <<": " << currentPosition.x << ", " << currentPosition.y << ", " << currentPosition.z << " :: " << line << std::endl;
+		if (!krlWriteProgram(fullSavePath, krlCompileStreamInterpreter(mGetKrlSettings(), programName))
+			|| !krlWriteProgram(configPath, krlCompileStreamConfig(mStreamHost.get(), mStreamPort.get(), krlStreamBufferLimit))) {
+			std::cout << "Could not write " << fullSavePath << " / " << configPath << std::endl;
+		}
+		else {
+			std::cout << "Copy " << configPath << " to C:\\KRC\\ROBOTER\\Config\\User\\Common\\EthernetKRL on the controller" << std::endl;
+		}
 
-			//Save for comparison with KRL in gui 
-			if (processFlag) {
-				gCodeFilteredBuffer.push_back(line);
-			}
+	}
 
-			//Save position for references in arcs
-			lastPosition = currentPosition;
-			lineNumber++;
+	mStreamSaveInterpreter.set(false);
 
-		
+}
 
+void ofApp::mWatchRunListener(bool& sender) {
 
-		}
+	//Always tear down the running service, a new one picks up changed directories and worker count
+	watchService.reset();
 
-		guiPoly = cPoly;
+	if (sender) {
 
-	}
-	else {
+		//settings.xml holds the conversion parameters, the gui values only fill in what is missing there
+		krlSettings defaults = mGetKrlSettings();
+		krlLoadSettings(ofxPanelDefaultFilename, defaults);
 
-		std::cout << "gCode buffer is empty, stop." << std::endl;
+		watchService = std::make_unique<krlWatchService>(mWatchInputDir.get(), mWatchOutputDir.get(), defaults, mWatchWorkers.get());
+		watchService->start();
 
 	}
 
-	mFileProcess.set(false);
-
 }
 
 //--------------------------------------------------------------
@@ -650,38 +633,84 @@ void ofApp::update(){
 void ofApp::draw(){
 
 
+	//Live preview of rotation and tilt, the translation is left out so the part stays in view
+	krlPlacement placement = krlMakePlacement(mGetKrlSettings());
+
+	glm::mat4 placementMatrix = glm::mat4(
+		glm::vec4(placement.xAxis, 0),
+		glm::vec4(placement.yAxis, 0),
+		glm::vec4(placement.zAxis, 0),
+		glm::vec4(0, 0, 0, 1));
+
 	guiCam.begin();
-	guiPoly.draw();
+
+	//Slicer axes for reference
+	ofDrawAxis(100);
+
+	ofPushMatrix();
+	ofMultMatrix(placementMatrix);
+
+	conversion.guiPoly.draw();
 
 	ofSetColor(255, 0, 0);
 
-	for (auto i : midPointCollection) {
+	for (auto i : conversion.midPointCollection) {
 
 		ofDrawSphere(i, 2);
 
 	}
 
+	//Layer selected in the layer navigation
+	ofSetColor(255, 255, 0);
+	ofSetLineWidth(3);
+	guiLayerPoly.draw();
+	ofSetLineWidth(1);
+
+	//Move picked with the mouse
+	if (guiPickedMove >= 0 && (size_t)guiPickedMove < conversion.toolpathBuffer.size()) {
+		ofSetColor(0, 255, 0);
+		ofDrawSphere(conversion.toolpathBuffer.at(guiPickedMove).target, 4);
+	}
+
+	//Pre-flight violations, capped so a wrong origin with every point outside doesn't stall the preview.
+	//They are sorted by move, so the last one tells if they still belong to this toolpath.
+	bool violationsValid = violations.empty() || violations.back().move < conversion.toolpathBuffer.size();
+
+	ofSetColor(255, 0, 255);
+	for (size_t i = 0; violationsValid && i < violations.size() && i < 2000; i++) {
+		ofDrawSphere(conversion.toolpathBuffer.at(violations[i].move).target, 3);
+	}
+
 	ofSetColor(255, 255, 255);
 
+	ofPopMatrix();
+
 	guiCam.end();
 
-	if (guiToggleCodeView && gCodeFilteredBuffer.size() > 0) {
+	if (guiToggleCodeView && conversion.gCodeFilteredBuffer.size() > 0) {
 
 		ofRectangle gCodeView(ofGetWindowWidth() - 500, 15, 500, ofGetWindowHeight());
 		ofRectangle krlCodeView(ofGetWindowWidth() - 1500, 15, 1000, ofGetWindowHeight());
 
 		int viewPos = guiCodeViewPosition;
+		int krlViewPos = guiKrlViewPosition;
 
 		if (guiCodeViewPosition < 0) {
 			viewPos = 0;
 		}
-		if (guiCodeViewPosition > gCodeFilteredBuffer.size()) {
-			viewPos = gCodeFilteredBuffer.size() - 1;
+		if (guiCodeViewPosition > conversion.gCodeFilteredBuffer.size()) {
+			viewPos = conversion.gCodeFilteredBuffer.size() - 1;
 		}
+		if (guiKrlViewPosition > conversion.krlCodeBuffer.size()) {
+			krlViewPos = std::max<int>(0, conversion.krlCodeBuffer.size() - 1);
+		}
+
+		//Only build the lines that fit in the view, full buffers can be millions of lines
+		int viewLines = gCodeView.height / 13 + 1;
 
 		std::string gCodeViewString = "";
-		for (int i = viewPos; i < gCodeFilteredBuffer.size(); i++) {
-			gCodeViewString += ofToString(i) + ". " + gCodeFilteredBuffer.at(i) + '\n';
+		for (int i = viewPos; i < conversion.gCodeFilteredBuffer.size() && i < viewPos + viewLines; i++) {
+			gCodeViewString += ofToString(i) + ". " + conversion.gCodeFilteredBuffer.at(i) + '\n';
 		}
 		
 		ofSetColor(0, 0, 0);
@@ -689,17 +718,39 @@ void ofApp::draw(){
 		ofSetColor(255, 255, 255);
 		ofDrawBitmapString(gCodeViewString, gCodeView.getTopLeft().x, gCodeView.getTopLeft().y+30);
 
+		//Violations are sorted by move and so by KRL line, find the first one in view
+		auto violationsEnd = violationsValid ? violations.end() : violations.begin();
+		auto violation = std::lower_bound(violations.begin(), violationsEnd, krlViewPos, [this](const krlViolation& v, int line) {
+			return (int)conversion.toolpathBuffer.at(v.move).krlLine < line;
+		});
+		std::vector<int> violationRows;
+
 		std::string krlViewString = "";
-		for (int i = viewPos; i < krlCodeBuffer.size(); i++) {
-			krlViewString += ofToString(i) + ". " + krlCodeBuffer.at(i) + '\n';
+		for (int i = krlViewPos; i < conversion.krlCodeBuffer.size() && i < krlViewPos + viewLines; i++) {
+			krlViewString += ofToString(i) + ". " + conversion.krlCodeBuffer.at(i);
+
+			if (violation != violationsEnd && conversion.toolpathBuffer.at(violation->move).krlLine == (uint32_t)i) {
+				krlViewString += "   <- " + violation->reason;
+				violationRows.push_back(i - krlViewPos);
+				violation++;
+			}
+
+			krlViewString += '\n';
 		}
 
 		ofSetColor(0, 0, 0);
 		ofDrawRectangle(krlCodeView);
+
+		//Bitmap font lines are 8 * 1.7 pixels apart
+		ofSetColor(140, 0, 0);
+		for (int row : violationRows) {
+			ofDrawRectangle(krlCodeView.x, krlCodeView.y + 30 + row * 13.6f - 11, krlCodeView.width, 13.6f);
+		}
+
 		ofSetColor(255, 255, 255);
 		ofDrawBitmapString(krlViewString,krlCodeView.getTopLeft().x,krlCodeView.getTopLeft().y+30);
 		
-		std::string cViewInstruct = "Keys: (v) - toggle this code view, (+) - advance viewing line, (-) - subtract viewing line";
+		std::string cViewInstruct = "Keys: (v) - toggle this code view, (+) - advance viewing line, (-) - subtract viewing line, click path - jump to its line,\n(page up/down) - next/previous layer, (n) - next pre-flight violation";
 		ofDrawBitmapString(cViewInstruct, krlCodeView.getTopLeft().x, krlCodeView.getTopLeft().y + 15);
 
 	}
@@ -707,24 +758,81 @@ void ofApp::draw(){
 
 	menu.draw();
 
+	//Background services report under the menu, the info text moves down to make room
+	std::vector<std::string> statusLines;
+	if (watchService) statusLines.push_back(watchService->getStatus());
+	if (streamer) statusLines.push_back(streamer->getStatus());
+	if (streamSimulator) statusLines.push_back(streamSimulator->getStatus());
+	if (!checkStatus.empty()) statusLines.push_back(checkStatus);
+
+	//Code, saves, streaming and the check all use the placement of the last process, the preview is live
+	if (!conversion.toolpathBuffer.empty() && !krlSamePlacement(mGetKrlSettings(), conversion.settings)) {
+		statusLines.push_back("Placement changed since the last process, process again before saving or streaming");
+	}
+
+	if (mPrintTilt.get()) {
+		ofVec3f probe[3] = { mPrintProbe[0].get(), mPrintProbe[1].get(), mPrintProbe[2].get() };
+		ofVec3f normal;
+		ofVec3f center;
+
+		if (krlFitBedPlane(probe, normal, center)) {
+			statusLines.push_back("Bed tilt: " + ofToString(ofRadToDeg(acos(normal.z)), 3) + " deg, plane Z " + ofToString(center.z, 1) + " mm at probe center");
+		}
+		else {
+			statusLines.push_back("Bed tilt: probe points don't span a plane, compensation off");
+		}
+	}
+
+	float infoY = menu.getHeight() + 50;
+	if (!statusLines.empty()) {
+		ofDrawBitmapStringHighlight(ofJoinString(statusLines, "\n"), 10, menu.getHeight() + 30);
+		infoY += (statusLines.size() - 1) * 14 + 10;
+	}
 	
-	if(infoToggle) ofDrawBitmapStringHighlight(softwareDescription, 10, menu.getHeight() + 50);
+	if(infoToggle) ofDrawBitmapStringHighlight(softwareDescription, 10, infoY);
 
 	ofEnableAlphaBlending();
 	logoImg.draw(ofGetWindowWidth()- (logoImg.getWidth() / 2)-30,ofGetWindowHeight()- (logoImg.getHeight() / 2)-10,logoImg.getWidth()/2,logoImg.getHeight()/2);
 	ofDisableAlphaBlending();
 }
 
+//--------------------------------------------------------------
+void ofApp::exit(){
+	watchService.reset();
+	streamer.reset();
+	streamSimulator.reset();
+}
+
 //--------------------------------------------------------------
 void ofApp::keyPressed(int key){
-	if (key == '-') guiCodeViewPosition--;
-	if (key == '+') guiCodeViewPosition++;
+	if (key == '-') {
+		guiCodeViewPosition--;
+		guiKrlViewPosition--;
+	}
+	if (key == '+') {
+		guiCodeViewPosition++;
+		guiKrlViewPosition++;
+	}
+	if (key == OF_KEY_PAGE_UP && mLayerSelect.get() < mLayerSelect.getMax()) mLayerSelect.set(mLayerSelect.get() + 1);
+	if (key == OF_KEY_PAGE_DOWN && mLayerSelect.get() > 0) mLayerSelect.set(mLayerSelect.get() - 1);
 }
 
 //--------------------------------------------------------------
 void ofApp::keyReleased(int key){
 	if (key == 'v') guiToggleCodeView = !guiToggleCodeView;
 	if (key == 'h') infoToggle = !infoToggle;
+
+	//Jump to the first violation below the KRL view position, wrapping around at the end
+	if (key == 'n' && !violations.empty() && violations.back().move < conversion.toolpathBuffer.size()) {
+		auto next = std::upper_bound(violations.begin(), violations.end(), guiKrlViewPosition, [this](int line, const krlViolation& v) {
+			return line < (int)conversion.toolpathBuffer.at(v.move).krlLine;
+		});
+		if (next == violations.end()) next = violations.begin();
+
+		guiKrlViewPosition = conversion.toolpathBuffer.at(next->move).krlLine;
+		guiCodeViewPosition = conversion.toolpathBuffer.at(next->move).gCodeLine;
+		guiToggleCodeView = true;
+	}
 }
 
 //--------------------------------------------------------------
@@ -739,12 +847,53 @@ void ofApp::mouseDragged(int x, int y, int button){
 
 //--------------------------------------------------------------
 void ofApp::mousePressed(int x, int y, int button){
-
+	guiPressPosition = ofVec2f(x, y);
 }
 
 //--------------------------------------------------------------
 void ofApp::mouseReleased(int x, int y, int button){
 
+	//Pick on a click only, a drag is guiCam rotating the view
+	if (button != OF_MOUSE_BUTTON_LEFT || guiPressPosition.distance(ofVec2f(x, y)) > 3) return;
+	if (menu.getShape().inside(x, y)) return;
+	if (guiToggleCodeView && !conversion.gCodeFilteredBuffer.empty() && x > ofGetWindowWidth() - 1500) return;
+
+	guiPickMove(x, y);
+}
+
+void ofApp::guiPickMove(int x, int y) {
+
+	if (pickIndex.empty()) return;
+
+	uint64_t startTime = ofGetElapsedTimeMicros();
+
+	//Two rays a few pixels apart give the pick tolerance at the near and the far plane
+	const float pickPixels = 6;
+	ofVec3f nearA = guiCam.screenToWorld(glm::vec3(x, y, -1));
+	ofVec3f farA = guiCam.screenToWorld(glm::vec3(x, y, 1));
+	ofVec3f nearB = guiCam.screenToWorld(glm::vec3(x + pickPixels, y, -1));
+	ofVec3f farB = guiCam.screenToWorld(glm::vec3(x + pickPixels, y, 1));
+
+	float length = nearA.distance(farA);
+	float radius = nearA.distance(nearB);
+	float slope = (farA.distance(farB) - radius) / length;
+
+	//The preview is drawn rotated, bring the ray back to slicer coordinates of the index
+	krlPlacement placement = krlMakePlacement(mGetKrlSettings());
+	auto toSlicer = [&placement](const ofVec3f& p) {
+		return ofVec3f(p.dot(placement.xAxis), p.dot(placement.yAxis), p.dot(placement.zAxis));
+	};
+
+	int move = pickIndex.pick(toSlicer(nearA), toSlicer((farA - nearA) / length), length, radius, slope);
+
+	std::cout << "Pick at " << x << ", " << y << ": move " << move << " in " << ofGetElapsedTimeMicros() - startTime << " us" << std::endl;
+
+	if (move < 0) return;
+
+	guiPickedMove = move;
+	guiCodeViewPosition = conversion.toolpathBuffer.at(move).gCodeLine;
+	guiKrlViewPosition = conversion.toolpathBuffer.at(move).krlLine;
+	guiToggleCodeView = true;
 }
 
 //--------------------------------------------------------------
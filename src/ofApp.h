@@ -2,6 +2,13 @@
 
 #include "ofMain.h"
 #include "ofxGui.h"
+#include "krlConverter.h"
+#include "krlCache.h"
+#include "krlWatchService.h"
+#include "krlPickIndex.h"
+#include "krlStream.h"
+#include "krlTable.h"
+#include "krlValidator.h"
 
 class ofApp : public ofBaseApp{
 
@@ -9,6 +16,7 @@ class ofApp : public ofBaseApp{
 		void setup();
 		void update();
 		void draw();
+		void exit();
 
 		void keyPressed(int key);
 		void keyReleased(int key);
@@ -23,20 +31,24 @@ class ofApp : public ofBaseApp{
 		void gotMessage(ofMessage msg);
 
 		std::vector<std::string>gCodeBuffer;
-		std::vector<std::string>gCodeFilteredBuffer;
-		std::vector<std::string>krlCodeBuffer;
-		ofPolyline guiPoly;
-		std::vector<ofVec3f>midPointCollection;
+		uint64_t gCodeHash;
+		krlConversion conversion;
 		
 		ofxPanel menu;
 		ofParameterGroup mFileMan;
 		ofParameter<bool> mFileOpen;
 		ofParameter<bool> mFileSave;
 		ofParameter<bool> mFileProcess;
+		ofParameter<bool> mFileUseCache;
+		ofParameter<bool> mFileSaveTable;
+		ofParameter<int> mFileTableChunk;
 
 		void mFileOpenListener(bool& sender);
 		void mFileSaveListener(bool& sender);
 		void mFileProcessListener(bool& sender);
+		void mFileSaveTableListener(bool& sender);
+
+		std::string mAskSrcSavePath();
 
 		ofParameterGroup mExtrusionMan;
 		ofParameter<float> mExtLayerHeight;
@@ -50,11 +62,73 @@ class ofApp : public ofBaseApp{
 		ofParameter<ofVec2f>mPrintOrigin;
 		ofParameter<float>mPrintHeightOffset;
 		ofParameter<float>mPrintSpeed;
+		ofParameter<float>mPrintRotation;
+		ofParameter<bool>mPrintTilt;
+		ofParameter<ofVec3f>mPrintProbe[3];
+
+		krlSettings mGetKrlSettings();
+
+		ofParameterGroup mLayerMan;
+		ofParameter<int> mLayerSelect;
+		ofParameter<float> mLayerApproachHeight;
+		ofParameter<bool> mLayerSaveRestart;
+
+		void mLayerSelectListener(int& sender);
+		void mLayerSaveRestartListener(bool& sender);
+
+		ofParameterGroup mWatchMan;
+		ofParameter<bool> mWatchRun;
+		ofParameter<std::string> mWatchInputDir;
+		ofParameter<std::string> mWatchOutputDir;
+		ofParameter<int> mWatchWorkers;
+
+		void mWatchRunListener(bool& sender);
+
+		std::unique_ptr<krlWatchService> watchService;
+
+		ofParameterGroup mCheckMan;
+		ofParameter<bool> mCheckRun;
+		ofParameter<bool> mCheckOnProcess;
+		ofParameter<ofVec3f> mCheckWorkspaceMin;
+		ofParameter<ofVec3f> mCheckWorkspaceMax;
+		ofParameter<std::string> mCheckKeepOutFile;
+		ofParameter<float> mCheckMaxArcRadius;
+		ofParameter<float> mCheckMaxMidpointDeviation;
+
+		void mCheckRunListener(bool& sender);
+
+		std::vector<krlViolation> violations;
+		std::string checkStatus;
+
+		ofParameterGroup mStreamMan;
+		ofParameter<bool> mStreamRun;
+		ofParameter<bool> mStreamOnProcess;
+		ofParameter<bool> mStreamSimulate;
+		ofParameter<std::string> mStreamHost;
+		ofParameter<int> mStreamPort;
+		ofParameter<int> mStreamWindow;
+		ofParameter<int> mStreamBatch;
+		ofParameter<bool> mStreamSaveInterpreter;
+
+		void mStreamRunListener(bool& sender);
+		void mStreamSaveInterpreterListener(bool& sender);
+
+		std::unique_ptr<krlStreamer> streamer;
+		std::unique_ptr<krlStreamSimulator> streamSimulator;
 		
 
 		ofEasyCam guiCam;
 		bool guiToggleCodeView;
 		unsigned int guiCodeViewPosition;
+		unsigned int guiKrlViewPosition;
+
+		ofPolyline guiLayerPoly;
+
+		krlPickIndex pickIndex;
+		int guiPickedMove;
+		ofVec2f guiPressPosition;
+
+		void guiPickMove(int x, int y);
 
 		std::string softwareDescription;
 		bool infoToggle;